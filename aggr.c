@@ -0,0 +1,247 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * aggr.c: CPU, RSS, I/O and process counts summed per user, per group from
+ * the configuration file and per session. A process remembers what it
+ * added to its aggregates, so when it changes only the difference is
+ * applied, and when it exits it is taken out again. The aggregates are
+ * never recomputed from the whole process table.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct aggr_table	aggrs[AGGR_NKINDS];		/* users, groups, sessions	*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			aggr_lookup			(int, int, struct process_info *);
+void		aggr_count			(int, int, int, double, double, double);
+unsigned int	aggr_groups		(const char *);
+int			aggr_comp			(const struct aggr_info **,
+									 const struct aggr_info **);
+
+/* ------------------------------------------------------------------------
+ * aggr_lookup: Return the index of the aggregate of `kind' with `key',
+ * adding it to the table if it is new. Process `p' gives it its name. */
+
+int aggr_lookup( int kind, int key, struct process_info * p)
+{
+	struct aggr_table * t = aggrs + kind;
+	struct aggr_info * a;
+	int i, h;
+
+	h = key & (AGGR_HASH_SIZE-1);
+	for (i=t->hash[h]; i != -1; i=t->a[i].hnext)
+		if (t->a[i].key == key)
+			return (i);
+
+	for (i=0; (i < t->maxi) && t->a[i].nprocs; i++);
+	if (i == t->maxi) {
+		if (i == t->size)
+			t->a = xrealloc( t->a, (t->size *= 2) *
+					sizeof (struct aggr_info));
+		t->maxi++;
+	}
+	a = t->a + i;
+	memset( a, 0, sizeof (struct aggr_info));
+	a->key = key;
+	switch (kind) {
+	case AGGR_USER:
+		strnzcpy( a->name, p->user, AGGR_NAME_SIZE);
+		break;
+	case AGGR_GROUP:
+		strnzcpy( a->name, groups[key].name, AGGR_NAME_SIZE);
+		break;
+	case AGGR_SESSION:
+		if ((h = proc_lookup( key)) != -1)
+			strnzcpy( a->name, procs[h].comm, AGGR_NAME_SIZE);
+		else
+			sprintf( a->name, "%d", key);
+		h = key & (AGGR_HASH_SIZE-1);
+		break;
+	}
+	a->hnext = t->hash[h];
+	t->hash[h] = i;
+	return (i);
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_count: Add `n' processes and `cpu', `rss' and `io' to aggregate `i'
+ * of `kind'. An aggregate without processes is removed. */
+
+void aggr_count( int kind, int i, int n, double cpu, double rss, double io)
+{
+	struct aggr_table * t = aggrs + kind;
+	struct aggr_info * a = t->a + i;
+	int * p;
+
+	a->nprocs += n;
+	a->cpu += cpu;
+	a->rss += rss;
+	a->io += io;
+	if (a->nprocs)
+		return;
+	for (p=&t->hash[a->key & (AGGR_HASH_SIZE-1)]; *p != -1;
+			p=&t->a[*p].hnext)
+		if (*p == i) {
+			*p = a->hnext;
+			break;
+		}
+	if (t->maxi && !t->a[t->maxi-1].nprocs)
+		t->maxi--;
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_groups: Return the groups `user' is a member of, as a bit mask.
+ * Only the first AGGR_MAX_GROUPS groups are aggregated. */
+
+unsigned int aggr_groups( const char * user)
+{
+	unsigned int mask;
+	int i, j;
+
+	for (i=mask=0; (i < ngroups) && (i < AGGR_MAX_GROUPS); i++)
+		for (j=0; j<groups[i].nmembers; j++)
+			if (!strcmp( groups[i].members[j].name, user)) {
+				mask |= 1 << i;
+				break;
+			}
+	return (mask);
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_remove: Take process `p' out of its aggregates. */
+
+void aggr_remove( struct process_info * p)
+{
+	int i;
+
+	if (p->agg_user == -1)
+		return;
+	aggr_count( AGGR_USER, p->agg_user, -1, -p->agg_cpu, -p->agg_rss,
+			-p->agg_io);
+	aggr_count( AGGR_SESSION, p->agg_session, -1, -p->agg_cpu, -p->agg_rss,
+			-p->agg_io);
+	for (i=0; (i < ngroups) && (i < AGGR_MAX_GROUPS); i++)
+		if (p->agg_groups & (1U << i))
+			aggr_count( AGGR_GROUP, aggr_lookup( AGGR_GROUP, i, p), -1,
+					-p->agg_cpu, -p->agg_rss, -p->agg_io);
+	p->agg_user = -1;
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_update: Bring the aggregates of process `p' up to date. If it is
+ * still in the same ones, only the change in its values is added. A
+ * process that the filter rejects, or whose owner is not known yet, is not
+ * counted. */
+
+void aggr_update( struct process_info * p)
+{
+	double cpu, rss, io;
+	unsigned int mask;
+	int i, n;
+
+	if (p->filtered || !p->user[0]) {
+		aggr_remove( p);
+		return;
+	}
+	mask = aggr_groups( p->user);
+	if ((p->agg_user == -1) ||
+			(aggrs[AGGR_USER].a[p->agg_user].key != p->uid) ||
+			(aggrs[AGGR_SESSION].a[p->agg_session].key != p->session) ||
+			(p->agg_groups != mask)) {
+		aggr_remove( p);
+		p->agg_user = aggr_lookup( AGGR_USER, p->uid, p);
+		p->agg_session = aggr_lookup( AGGR_SESSION, p->session, p);
+		p->agg_groups = mask;
+		p->agg_cpu = p->agg_rss = p->agg_io = 0;
+		n = 1;
+	} else
+		n = 0;
+
+	cpu = p->pct_cpu - p->agg_cpu;
+	rss = p->rss - p->agg_rss;
+	io = p->io_rrate + p->io_wrate - p->agg_io;
+	aggr_count( AGGR_USER, p->agg_user, n, cpu, rss, io);
+	aggr_count( AGGR_SESSION, p->agg_session, n, cpu, rss, io);
+	for (i=0; (i < ngroups) && (i < AGGR_MAX_GROUPS); i++)
+		if (mask & (1U << i))
+			aggr_count( AGGR_GROUP, aggr_lookup( AGGR_GROUP, i, p), n,
+					cpu, rss, io);
+	p->agg_cpu = p->pct_cpu;
+	p->agg_rss = p->rss;
+	p->agg_io = p->io_rrate + p->io_wrate;
+
+	/* The session is named after its leader, once it is seen */
+
+	if (p->pid == p->session)
+		strnzcpy( aggrs[AGGR_SESSION].a[p->agg_session].name, p->comm,
+				AGGR_NAME_SIZE);
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_comp: Compare two aggregates according to `aggrsort'. Used with
+ * qsort(). */
+
+int aggr_comp( const struct aggr_info ** one, const struct aggr_info ** two)
+{
+	const struct aggr_info * a = *one, * b = *two;
+
+	switch (aggrsort) {
+	case AGGSORT_RSS:
+		return ((a->rss < b->rss) - (a->rss > b->rss));
+	case AGGSORT_IO:
+		return ((a->io < b->io) - (a->io > b->io));
+	case AGGSORT_PROCS:
+		return (b->nprocs - a->nprocs);
+	case AGGSORT_CPU:
+	default:
+		return ((a->cpu < b->cpu) - (a->cpu > b->cpu));
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_sort: Store the top `max' aggregates of `kind' in `top'. Returns
+ * the number of aggregates stored. */
+
+int aggr_sort( int kind, struct aggr_info ** top, int max)
+{
+	struct aggr_table * t = aggrs + kind;
+	struct aggr_info ** all;
+	int i, n;
+
+	all = xmalloc( (t->maxi + 1) * sizeof (struct aggr_info *));
+	for (i=n=0; i<t->maxi; i++)
+		if (t->a[i].nprocs)
+			all[n++] = t->a + i;
+	qsort( all, n, sizeof (struct aggr_info *),
+			(int (*)(const void *, const void *)) aggr_comp);
+	if (n > max)
+		n = max;
+	memcpy( top, all, n * sizeof (struct aggr_info *));
+	free( all);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * aggr_init: Allocate the aggregate tables. */
+
+int aggr_init( void)
+{
+	int i, k;
+
+	for (k=0; k<AGGR_NKINDS; k++) {
+		aggrs[k].maxi = 0;
+		aggrs[k].size = 16;
+		aggrs[k].a = xmalloc( aggrs[k].size * sizeof (struct aggr_info));
+		for (i=0; i<AGGR_HASH_SIZE; i++)
+			aggrs[k].hash[i] = -1;
+	}
+	return (0);
+}
@@ -36,7 +36,11 @@ void	yy_group_finish	(char *);
 }
 
 %token MEM FREE USED INFO PID CMDLINE NAME PRIO WCHAN
-%token SORT CPU RSS VSIZE MAPFILE GROUP DELAY DISKFREE
+%token SORT CPU RSS VSIZE MAPFILE GROUP DELAY DISKFREE FILTER
+%token PROCROOT UTMPFILE BUDGET FSINCLUDE FSEXCLUDE DISKINCLUDE DISKEXCLUDE
+%token IO IOREAD IOWRITE NETINCLUDE NETEXCLUDE PSS USS HISTORY
+%token CPU1 CPU5 CPU15 RUNQ BLKIO MAJFLT MINFLT CSW FAULTS MAJFLTWARN
+%token PERIOD WATCH WATCHPERIOD
 
 %token <cval> CHAR
 %token <ival> INT
@@ -62,16 +66,52 @@ float:	  FLOAT						{ $$ = $1; }
 line:	SORT CPU					{ sort = SORT_CPU; }
 		| SORT RSS					{ sort = SORT_RSS; }
 		| SORT VSIZE				{ sort = SORT_VSIZE; }
+		| SORT IOREAD				{ sort = SORT_IO_READ; }
+		| SORT IOWRITE				{ sort = SORT_IO_WRITE; }
+		| SORT PSS					{ sort = SORT_PSS; }
+		| SORT USS					{ sort = SORT_USS; }
+		| SORT CPU1					{ sort = SORT_CPU_1M; }
+		| SORT CPU5					{ sort = SORT_CPU_5M; }
+		| SORT CPU15				{ sort = SORT_CPU_15M; }
+		| SORT RUNQ					{ sort = SORT_RUNQ; }
+		| SORT BLKIO				{ sort = SORT_BLKIO; }
+		| SORT MAJFLT				{ sort = SORT_MAJFLT; }
+		| SORT MINFLT				{ sort = SORT_MINFLT; }
+		| SORT CSW					{ sort = SORT_CSW; }
 		| INFO PID					{ info = INFO_PID; }
 		| INFO NAME					{ info = INFO_NAME; }
 		| INFO CMDLINE				{ info = INFO_CMDLINE; }
 		| INFO PRIO					{ info = INFO_PRIO; }
 		| INFO WCHAN				{ info = INFO_WCHAN; }
+		| INFO IO					{ info = INFO_IO; }
+		| INFO FAULTS				{ info = INFO_FAULTS; }
+		| INFO CSW					{ info = INFO_CSW; }
 		| MEM FREE					{ memory = MEM_FREE; }
 		| MEM USED					{ memory = MEM_USED; }
 		| MAPFILE STRING			{ mapfile = $2; } 
+		| PROCROOT STRING			{ procroot = $2; }
+		| UTMPFILE STRING			{ utmpfile = $2; }
 		| DELAY float				{ delay = $2; }
+		| BUDGET float				{ budget = $2; }
+		| PERIOD STRING float		{ if (source_set( $2, $3)) {
+										yyerror( "unknown source");
+										YYABORT;
+									  } }
 		| DISKFREE INT				{ min_diskfree = $2; }
+		| MAJFLTWARN INT			{ majflt_warn = $2; }
+		| FSINCLUDE STRING			{ fsinclude = $2; }
+		| FSEXCLUDE STRING			{ fsexclude = $2; }
+		| DISKINCLUDE STRING		{ diskinclude = $2; }
+		| DISKEXCLUDE STRING		{ diskexclude = $2; }
+		| NETINCLUDE STRING			{ netinclude = $2; }
+		| NETEXCLUDE STRING			{ netexclude = $2; }
+		| HISTORY INT				{ hist_mem = $2; }
+		| WATCH STRING				{ watch_names = $2; }
+		| WATCHPERIOD float			{ watch_period = $2; }
+		| FILTER STRING				{ if (filter_set( $2)) {
+										yyerror( filter_errmsg);
+										YYABORT;
+									  } }
 		| GROUP STRING '{' gmember '}'	{ yy_group_finish( $2); }
 ;
 
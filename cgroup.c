@@ -0,0 +1,381 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * cgroup.c: Per-cgroup statistics from the cgroup v2 hierarchy. Only the
+ * cgroups that contain processes are tracked. Their membership is read
+ * from /proc/<pid>/cgroup, their statistics from the cgroup directory. The
+ * statistics files are kept open and re-read with pread(), so a refresh
+ * costs one system call per file.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+char *					cgroup_root	= "/sys/fs/cgroup";
+int						cgroups_maxi	= 0;	/* Max index in cgroup table */
+int						cgroups_size	= 32;	/* initial cgroup table size */
+int						cgroup_ok		= 0;	/* Is cgroup v2 mounted?	*/
+int						cgserial		= 0;	/* # of cgroup updates		*/
+int						cghash[CG_HASH_SIZE];	/* Path hash chains		*/
+
+struct cgroup_info *	cgroups			= NULL;	/* all cgroups				*/
+
+/* The statistics files, in the order of the `fds' field */
+
+char * cgfiles[CG_NFILES] = {
+	"cpu.stat", "memory.current", "memory.stat", "io.stat", "pids.current"
+};
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+unsigned	cg_hashpath			(const char *);
+int			cg_lookup			(const char *);
+void		cg_free				(int);
+int			cg_read				(struct cgroup_info *, int, char *, int);
+void		cg_setname			(struct cgroup_info *);
+unsigned long long	cg_field	(const char *, const char *);
+
+/* ------------------------------------------------------------------------
+ * cg_hashpath: Hash function for cgroup paths. */
+
+unsigned cg_hashpath( const char * path)
+{
+	unsigned h = 0;
+
+	while (*path)
+		h = h * 31 + (unsigned char) *path++;
+	return (h % CG_HASH_SIZE);
+}
+
+/* ------------------------------------------------------------------------
+ * cg_setname: Derive a short display name from the cgroup path. Strip the
+ * usual systemd suffixes and container runtime prefixes, so that the
+ * name starts with the unit name or the container id. */
+
+void cg_setname( struct cgroup_info * cg)
+{
+	char * prefixes[] = { "docker-", "cri-containerd-", "crio-", "libpod-",
+			NULL };
+	char * suffixes[] = { ".scope", ".service", ".slice", NULL };
+	const char * p;
+	int i, len;
+
+	p = strrchr( cg->path, '/');
+	p = (p && p[1]) ? p+1 : "/";
+	for (i=0; prefixes[i]; i++)
+		if (!strncmp( p, prefixes[i], strlen( prefixes[i]))) {
+			p += strlen( prefixes[i]);
+			break;
+		}
+	strnzcpy( cg->name, p, CG_NAME_SIZE);
+	len = strlen( cg->name);
+	for (i=0; suffixes[i]; i++)
+		if ((len > strlen( suffixes[i])) && !strcmp( cg->name + len -
+				strlen( suffixes[i]), suffixes[i])) {
+			cg->name[len - strlen( suffixes[i])] = '\000';
+			break;
+		}
+}
+
+/* ------------------------------------------------------------------------
+ * cg_lookup: Return the index of the cgroup with path `path', adding it to
+ * the table if it is new. */
+
+int cg_lookup( const char * path)
+{
+	int i, h, f;
+
+	h = cg_hashpath( path);
+	for (i=cghash[h]; i != -1; i=cgroups[i].hnext)
+		if (!strcmp( cgroups[i].path, path))
+			return (i);
+
+	for (i=0; i<cgroups_maxi && cgroups[i].path; i++);
+	if (i == cgroups_maxi) {
+		if (i == cgroups_size)
+			cgroups = xrealloc( cgroups, (cgroups_size *= 2) * sizeof
+					(struct cgroup_info));
+		i = cgroups_maxi++;
+	}
+	memset( cgroups+i, 0, sizeof (struct cgroup_info));
+	cgroups[i].path = xmalloc( strlen( path) + 1);
+	strcpy( cgroups[i].path, path);
+	for (f=0; f<CG_NFILES; f++)
+		cgroups[i].fds[f] = CG_UNOPENED;
+	cg_setname( cgroups+i);
+	cgroups[i].hnext = cghash[h];
+	cghash[h] = i;
+	return (i);
+}
+
+/* ------------------------------------------------------------------------
+ * cg_free: Remove cgroup `i' from the table and close its files. Processes
+ * that refer to it will re-read their membership. */
+
+void cg_free( int i)
+{
+	int f, *p;
+
+	for (p=&cghash[cg_hashpath( cgroups[i].path)]; *p != -1;
+			p=&cgroups[*p].hnext)
+		if (*p == i) {
+			*p = cgroups[i].hnext;
+			break;
+		}
+	for (f=0; f<CG_NFILES; f++)
+		if (cgroups[i].fds[f] >= 0)
+			close( cgroups[i].fds[f]);
+	free( cgroups[i].path);
+	cgroups[i].path = NULL;
+
+	for (f=0; f<procs_maxi; f++)
+		if (procs[f].cgroup == i)
+			procs[f].cgroup = -1;
+}
+
+/* ------------------------------------------------------------------------
+ * cg_read: Read statistics file `f' of cgroup `cg' into `buf'. The file is
+ * opened once and then re-read from offset zero. If we run out of file
+ * descriptors, we fall back to opening the file for every read. Returns
+ * the number of bytes read, or -1 on error. */
+
+int cg_read( struct cgroup_info * cg, int f, char * buf, int size)
+{
+	char fname[FILENAME_MAX];
+	int fd, n;
+
+	if (cg->fds[f] == CG_NOFILE)
+		return (-1);
+	if ((fd = cg->fds[f]) == CG_UNOPENED) {
+		snprintf( fname, FILENAME_MAX, "%s%s/%s", cgroup_root,
+				strcmp( cg->path, "/") ? cg->path : "", cgfiles[f]);
+		if ((fd = open( fname, O_RDONLY)) == -1) {
+			if ((errno != EMFILE) && (errno != ENFILE))
+				cg->fds[f] = CG_NOFILE;
+			return (-1);
+		}
+		cg->fds[f] = fd;
+	}
+	n = pread( fd, buf, size-1, 0);
+	if (n == -1) {
+		close( fd);
+		cg->fds[f] = CG_NOFILE;
+		return (-1);
+	}
+	buf[n] = '\000';
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * cg_field: Return the value of key `key' in a flat keyed file like
+ * cpu.stat or memory.stat. */
+
+unsigned long long cg_field( const char * buf, const char * key)
+{
+	int len = strlen( key);
+
+	while (buf) {
+		if (!strncmp( buf, key, len) && (buf[len] == ' '))
+			return (strtoull( buf+len+1, NULL, 10));
+		if ((buf = strchr( buf, '\n')))
+			buf++;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * cgroup_member: Find the cgroup of process `p'. Membership rarely changes,
+ * so it is read when a process is new and then every 16th update, spread
+ * out over the processes. */
+
+void cgroup_member( struct process_info * p)
+{
+	char fname[FILENAME_MAX];
+	char buf[BUFSIZ], * path, * nl;
+	int fd, n;
+
+	if (!cgroup_ok || (page != PAGE_CGROUPS))
+		return;
+	if ((p->cgroup != -1) && ((p->pid + cgserial) & 15))
+		return;
+
+	sprintf( fname, "%s/%d/cgroup", procroot, p->pid);
+	if ((fd = open( fname, O_RDONLY)) == -1)
+		return;
+	n = read( fd, buf, BUFSIZ-1);
+	close( fd);
+	if (n <= 0)
+		return;
+	buf[n] = '\000';
+
+	/* The v2 hierarchy is the line with hierarchy id 0 */
+
+	if (!strncmp( buf, "0::", 3))
+		path = buf + 3;
+	else if ((path = strstr( buf, "\n0::")))
+		path += 4;
+	else
+		return;
+	if ((nl = strchr( path, '\n')))
+		*nl = '\000';
+	p->cgroup = cg_lookup( path);
+}
+
+/* ------------------------------------------------------------------------
+ * cgroup_update: Roll up the process data per cgroup and read the cgroup
+ * statistics. Cgroups without member processes are dropped. */
+
+int cgroup_update( void)
+{
+	char buf[BUFSIZ], * p;
+	int i, n;
+	double usecs;
+	unsigned long long v, rbytes, wbytes;
+	struct cgroup_info * cg;
+
+	if (!cgroup_ok || (page != PAGE_CGROUPS))
+		return (0);
+	cgserial++;
+	usecs = jiffies * 1000000 / clk_tck;
+
+	for (i=0; i<cgroups_maxi; i++) {
+		cgroups[i].nprocs = 0;
+		cgroups[i].proc_cpu = 0;
+		cgroups[i].proc_rss = 0;
+	}
+	for (i=0; i<procs_maxi; i++) {
+		if (!procs[i].pid || procs[i].filtered || (procs[i].cgroup == -1))
+			continue;
+		cg = cgroups + procs[i].cgroup;
+		cg->nprocs++;
+		cg->proc_cpu += procs[i].pct_cpu;
+		cg->proc_rss += procs[i].rss;
+	}
+
+	for (i=0; i<cgroups_maxi; i++) {
+		cg = cgroups + i;
+		if (!cg->path)
+			continue;
+		if (!cg->nprocs) {
+			cg_free( i);
+			continue;
+		}
+
+		if (cg_read( cg, CG_CPU_STAT, buf, BUFSIZ) > 0) {
+			v = cg_field( buf, "usage_usec");
+			if (cg->serial == cgserial-1)
+				cg->pct_cpu = (v - cg->usage) * 100 / usecs;
+			cg->usage = v;
+		}
+		if (cg_read( cg, CG_MEMORY_CURRENT, buf, BUFSIZ) > 0)
+			cg->memory = strtoul( buf, NULL, 10);
+		if (cg_read( cg, CG_MEMORY_STAT, buf, BUFSIZ) > 0) {
+			cg->anon = cg_field( buf, "anon");
+			cg->file = cg_field( buf, "file");
+		}
+		if (cg_read( cg, CG_PIDS_CURRENT, buf, BUFSIZ) > 0)
+			cg->pids = atoi( buf);
+
+		/* io.stat has a line per device: "8:0 rbytes=N wbytes=N ..." */
+
+		if ((n = cg_read( cg, CG_IO_STAT, buf, BUFSIZ)) >= 0) {
+			rbytes = wbytes = 0;
+			for (p=buf; (p = strchr( p, ' ')); ) {
+				p++;
+				if (!strncmp( p, "rbytes=", 7))
+					rbytes += strtoull( p+7, NULL, 10);
+				else if (!strncmp( p, "wbytes=", 7))
+					wbytes += strtoull( p+7, NULL, 10);
+			}
+			if (cg->serial == cgserial-1) {
+				cg->rrate = (rbytes - cg->rbytes) * 1000000 / usecs;
+				cg->wrate = (wbytes - cg->wbytes) * 1000000 / usecs;
+			}
+			cg->rbytes = rbytes;
+			cg->wbytes = wbytes;
+		}
+		cg->serial = cgserial;
+	}
+
+	/* Try to decrement max counter by one ... */
+
+	if (cgroups_maxi && !cgroups[cgroups_maxi-1].path)
+		cgroups_maxi--;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * cgroup_comp: Compare two cgroups according to `cgsort'. Used with
+ * qsort(). */
+
+int cgroup_comp( const int * one, const int * two)
+{
+	struct cgroup_info * a = cgroups + *one, * b = cgroups + *two;
+
+	switch (cgsort) {
+	case CGSORT_MEM:
+		return ((a->memory < b->memory) - (a->memory > b->memory));
+	case CGSORT_IO:
+		return ((a->rrate + a->wrate < b->rrate + b->wrate) -
+				(a->rrate + a->wrate > b->rrate + b->wrate));
+	case CGSORT_PIDS:
+		return (b->pids - a->pids);
+	case CGSORT_CPU:
+	default:
+		return ((a->pct_cpu < b->pct_cpu) - (a->pct_cpu > b->pct_cpu));
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * cgroup_sort: Store the indices of the top `max' cgroups in `top'.
+ * Returns the number of cgroups stored. */
+
+int cgroup_sort( int * top, int max)
+{
+	int i, n;
+	int * all;
+
+	all = xmalloc( (cgroups_maxi + 1) * sizeof (int));
+	for (i=n=0; i<cgroups_maxi; i++)
+		if (cgroups[i].path)
+			all[n++] = i;
+	qsort( all, n, sizeof (int),
+			(int (*)(const void *, const void *)) cgroup_comp);
+	if (n > max)
+		n = max;
+	memcpy( top, all, n * sizeof (int));
+	free( all);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * cgroup_init: Check for a cgroup v2 hierarchy. A thousand cgroups with
+ * five open files each don't fit in the default file limit, so raise the
+ * soft limit as far as we may. */
+
+int cgroup_init( void)
+{
+	char fname[FILENAME_MAX];
+	struct rlimit rlim;
+	int i;
+
+	cgroups = xmalloc( cgroups_size * sizeof (struct cgroup_info));
+	for (i=0; i<CG_HASH_SIZE; i++)
+		cghash[i] = -1;
+
+	sprintf( fname, "%s/cgroup.controllers", cgroup_root);
+	if (access( fname, R_OK))
+		return (0);
+	cgroup_ok = 1;
+
+	if (!getrlimit( RLIMIT_NOFILE, &rlim) && (rlim.rlim_cur < rlim.rlim_max)) {
+		rlim.rlim_cur = rlim.rlim_max;
+		setrlimit( RLIMIT_NOFILE, &rlim);
+	}
+	return (0);
+}
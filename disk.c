@@ -0,0 +1,212 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * disk.c: Per-device I/O statistics from /proc/diskstats. The file is read
+ * with one system call and only the devices that pass the device filter
+ * are parsed. The rates are computed from the counter deltas between two
+ * updates.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int					ndisks			= 0;	/* # of entries in disk table */
+int					disks_size		= 16;	/* initial disk table size	*/
+int					disk_fd			= -1;	/* open /proc/diskstats		*/
+int					disk_bufsize	= 0;	/* size of disk_buf			*/
+int					disk_serial		= 0;	/* # of disk updates		*/
+char *				disk_buf		= NULL;	/* /proc/diskstats contents	*/
+
+struct disk_info *	disks			= NULL;	/* all block devices		*/
+
+/* Devices that are shown: whole disks by default, no partitions */
+
+char *	diskinclude	= "sd[a-z] sd[a-z][a-z] vd[a-z] xvd[a-z] hd[a-z] "
+					  "nvme[0-9]*n[0-9] nvme[0-9]*n[0-9][0-9] mmcblk[0-9] "
+					  "md[0-9]* dm-*";
+char *	diskexclude	= "";
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+struct disk_info *	disk_lookup	(int, const char *, int);
+int			disk_comp			(const int *, const int *);
+
+/* ------------------------------------------------------------------------
+ * disk_lookup: Find a device in the disk table, add it if it is new. The
+ * devices are in the same order in every read, so the entry at `hint' is
+ * tried first. */
+
+struct disk_info * disk_lookup( int hint, const char * name, int len)
+{
+	struct disk_info * d;
+	int i;
+
+	if ((hint < ndisks) && !strncmp( disks[hint].name, name, len) &&
+			!disks[hint].name[len])
+		return (disks + hint);
+	for (i=0; i<ndisks; i++)
+		if (!strncmp( disks[i].name, name, len) && !disks[i].name[len])
+			return (disks + i);
+
+	if (ndisks == disks_size)
+		disks = xrealloc( disks, (disks_size *= 2) *
+				sizeof (struct disk_info));
+	d = disks + ndisks++;
+	memset( d, 0, sizeof (struct disk_info));
+	if (len >= DISK_NAME_SIZE)
+		len = DISK_NAME_SIZE-1;
+	memcpy( d->name, name, len);
+	d->name[len] = '\000';
+	d->shown = match_list( diskinclude, d->name) &&
+			!match_list( diskexclude, d->name);
+	return (d);
+}
+
+/* ------------------------------------------------------------------------
+ * read_disks: Read /proc/diskstats and update the rates of the devices
+ * that are shown. Only done while the disk page is shown. */
+
+int read_disks( void)
+{
+	char fname[FILENAME_MAX];
+	char * p, * q, * name;
+	int i, n, len;
+	double now, dt, ios, dv[DISK_NFIELDS];
+	unsigned long long v[DISK_NFIELDS];
+	struct disk_info * d;
+
+	if (page != PAGE_DISKS)
+		return (0);
+	sprintf( fname, "%s/diskstats", procroot);
+	if (readfile( fname, &disk_fd, &disk_buf, &disk_bufsize) == -1) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+		return (1);
+	}
+	disk_serial++;
+	now = mono_time();
+
+	for (p=disk_buf, n=0; *p; p=q, n++) {
+		if ((q = strchr( p, '\n')))
+			*q++ = '\000';
+		else
+			q = p + strlen( p);
+
+		/* major minor name: skip the numbers, find the name */
+
+		p += strspn( p, " ");
+		p += strcspn( p, " ");
+		p += strspn( p, " ");
+		p += strcspn( p, " ");
+		name = p + strspn( p, " ");
+		len = strcspn( name, " ");
+		if (!len)
+			continue;
+		d = disk_lookup( n, name, len);
+		d->serial = disk_serial;
+		if (!d->shown)
+			continue;
+
+		p = name + len;
+		for (i=0; i<DISK_NFIELDS; i++)
+			v[i] = strtoull( p, &p, 10);
+
+		/* The tick counters are in milliseconds. A counter that went
+		 * back belongs to a new device with the same name. */
+
+		dt = now - d->t;
+		if (d->t && (dt > 0)) {
+			for (i=0; i<DISK_NFIELDS; i++)
+				dv[i] = (v[i] >= d->v[i]) ? v[i] - d->v[i] : 0;
+			d->riops = dv[DS_RD_IOS] / dt;
+			d->wiops = dv[DS_WR_IOS] / dt;
+			d->rbytes = dv[DS_RD_SECTORS] * 512 / dt;
+			d->wbytes = dv[DS_WR_SECTORS] * 512 / dt;
+			d->util = dv[DS_IO_TICKS] / (dt * 10);
+			if (d->util > 100)
+				d->util = 100;
+			d->queue = dv[DS_TIME_IN_QUEUE] / (dt * 1000);
+			ios = dv[DS_RD_IOS] + dv[DS_WR_IOS];
+			d->await = ios ? (dv[DS_RD_TICKS] + dv[DS_WR_TICKS]) / ios : 0;
+		}
+		memcpy( d->v, v, sizeof (v));
+		d->t = now;
+	}
+
+	/* Remove devices that are gone */
+
+	for (i=0; i<ndisks; i++)
+		if (disks[i].serial != disk_serial)
+			disks[i--] = disks[--ndisks];
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * disk_comp: Compare two devices according to `disksort'. Used with
+ * qsort(). */
+
+int disk_comp( const int * one, const int * two)
+{
+	struct disk_info * a = disks + *one, * b = disks + *two;
+	double ka, kb;
+
+	switch (disksort) {
+	case DISKSORT_IOPS:
+		ka = a->riops + a->wiops;
+		kb = b->riops + b->wiops;
+		break;
+	case DISKSORT_BYTES:
+		ka = a->rbytes + a->wbytes;
+		kb = b->rbytes + b->wbytes;
+		break;
+	case DISKSORT_AWAIT:
+		ka = a->await;
+		kb = b->await;
+		break;
+	case DISKSORT_QUEUE:
+		ka = a->queue;
+		kb = b->queue;
+		break;
+	case DISKSORT_UTIL:
+	default:
+		ka = a->util;
+		kb = b->util;
+		break;
+	}
+	return ((ka < kb) - (ka > kb));
+}
+
+/* ------------------------------------------------------------------------
+ * disk_sort: Store the indices of the top `max' shown devices in `top'.
+ * Returns the number of devices stored. */
+
+int disk_sort( int * top, int max)
+{
+	int i, n;
+	int * all;
+
+	all = xmalloc( (ndisks + 1) * sizeof (int));
+	for (i=n=0; i<ndisks; i++)
+		if (disks[i].shown)
+			all[n++] = i;
+	qsort( all, n, sizeof (int),
+			(int (*)(const void *, const void *)) disk_comp);
+	if (n > max)
+		n = max;
+	memcpy( top, all, n * sizeof (int));
+	free( all);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * disk_init: Allocate the disk table. */
+
+int disk_init( void)
+{
+	disks = xmalloc( disks_size * sizeof (struct disk_info));
+	return (0);
+}
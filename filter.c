@@ -0,0 +1,448 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * filter.c: Process filter expressions. A filter is a list of terms that
+ * are separated by whitespace. Each term has the form KEY OP VALUE, for
+ * example "user=build comm~^(cc1|ld) state=D cpu>5".
+ *
+ * Positive string terms (= and ~) on the same key are alternatives, all
+ * other terms must hold. The string terms of one key are compiled into a
+ * single regular expression, so that matching a key costs one regexec(),
+ * no matter how many patterns were given. The numeric terms are kept in a
+ * predicate chain.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Keys and operators */
+
+#define FKEY_COMM			0
+#define FKEY_STATE			1
+#define FKEY_USER			2
+#define FKEY_CMD			3
+#define FKEY_NSTRING		4	/* Keys below are numeric */
+#define FKEY_PID			4
+#define FKEY_UID			5
+#define FKEY_CPU			6
+#define FKEY_RSS			7
+#define FKEY_VSIZE			8
+#define FKEY_PRIO			9
+
+#define FOP_EQ				0
+#define FOP_NE				1
+#define FOP_LT				2
+#define FOP_LE				3
+#define FOP_GT				4
+#define FOP_GE				5
+#define FOP_MATCH			6
+#define FOP_NOMATCH			7
+
+struct fkey {
+	char *	name;
+	int		key;
+	int		level;		/* Collection level that provides the value */
+};
+
+struct fkey fkeys[] = {
+	{ "comm", FKEY_COMM, FILTER_STAT },
+	{ "name", FKEY_COMM, FILTER_STAT },
+	{ "state", FKEY_STATE, FILTER_STAT },
+	{ "user", FKEY_USER, FILTER_STATUS },
+	{ "cmd", FKEY_CMD, FILTER_CMDLINE },
+	{ "cmdline", FKEY_CMD, FILTER_CMDLINE },
+	{ "pid", FKEY_PID, FILTER_STAT },
+	{ "uid", FKEY_UID, FILTER_STATUS },
+	{ "cpu", FKEY_CPU, FILTER_STAT },
+	{ "rss", FKEY_RSS, FILTER_STAT },
+	{ "vsize", FKEY_VSIZE, FILTER_STAT },
+	{ "prio", FKEY_PRIO, FILTER_STAT },
+	{ NULL, 0, 0 }
+};
+
+struct fop {
+	char *	str;
+	int		op;
+};
+
+/* Two character operators must come first */
+
+struct fop fops[] = {
+	{ "!=", FOP_NE },
+	{ "!~", FOP_NOMATCH },
+	{ "<=", FOP_LE },
+	{ ">=", FOP_GE },
+	{ "=", FOP_EQ },
+	{ "~", FOP_MATCH },
+	{ "<", FOP_LT },
+	{ ">", FOP_GT },
+	{ NULL, 0 }
+};
+
+struct fpred {
+	int		key;
+	int		op;
+	int		level;
+	double	value;
+};
+
+/* A compiled filter. For every string key there is one regex for the
+ * alternatives that must match, and one for the terms that must not. */
+
+struct fcompiled {
+	int				npreds;
+	struct fpred *	preds;
+	int				level[FKEY_NSTRING];
+	int				havepos[FKEY_NSTRING];
+	int				haveneg[FKEY_NSTRING];
+	regex_t			pos[FKEY_NSTRING];
+	regex_t			neg[FKEY_NSTRING];
+};
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+char *				filter_expr	= NULL;		/* Current filter expression	*/
+char				filter_errmsg[MSG_TEXT_SIZE];
+
+struct fcompiled *	fc			= NULL;		/* Compiled form of filter_expr	*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void		filter_free			(struct fcompiled *);
+char *		filter_addpat		(char *, const char *, int);
+double		filter_value		(const char *, char **);
+
+/* ------------------------------------------------------------------------
+ * filter_free: Release a compiled filter. */
+
+void filter_free( struct fcompiled * f)
+{
+	int i;
+
+	if (!f)
+		return;
+	for (i=0; i<FKEY_NSTRING; i++) {
+		if (f->havepos[i])
+			regfree( &f->pos[i]);
+		if (f->haveneg[i])
+			regfree( &f->neg[i]);
+	}
+	free( f->preds);
+	free( f);
+}
+
+/* ------------------------------------------------------------------------
+ * filter_addpat: Add a pattern as an alternative to the (malloced) regex
+ * source `src'. If `literal' is nonzero, the pattern must match the whole
+ * string and regex special characters are escaped. */
+
+char * filter_addpat( char * src, const char * pat, int literal)
+{
+	int len;
+	char * p;
+
+	len = src ? strlen( src) : 0;
+	src = xrealloc( src, len + 2 * strlen( pat) + 8);
+	p = src + len;
+	if (len)
+		*p++ = '|';
+	*p++ = '(';
+	if (literal) {
+		*p++ = '^';
+		for (; *pat; pat++) {
+			if (strchr( ".[]()*+?{}|^$\\", *pat))
+				*p++ = '\\';
+			*p++ = *pat;
+		}
+		*p++ = '$';
+	} else {
+		strcpy( p, pat);
+		p += strlen( pat);
+	}
+	*p++ = ')';
+	*p = '\000';
+	return (src);
+}
+
+/* ------------------------------------------------------------------------
+ * filter_value: Parse a numeric value. A K, M or G suffix multiplies by
+ * 1024, 1024^2 or 1024^3. Returns with `*end' pointing past the value. */
+
+double filter_value( const char * str, char ** end)
+{
+	double v;
+
+	v = strtod( str, end);
+	if (*end == str)
+		return (0);
+	switch (toupper( **end)) {
+	case 'K':
+		v *= 1024; (*end)++;
+		break;
+	case 'M':
+		v *= 1024 * 1024; (*end)++;
+		break;
+	case 'G':
+		v *= 1024 * 1024 * 1024; (*end)++;
+		break;
+	}
+	return (v);
+}
+
+/* ------------------------------------------------------------------------
+ * filter_set: Compile the filter expression `expr' and make it the current
+ * filter. An empty (or NULL) expression clears the filter. On error, the current
+ * filter is kept, a message is left in `filter_errmsg' and 1 is returned. */
+
+int filter_set( const char * expr)
+{
+	char * buf, * term, * val, * end;
+	char * pos[FKEY_NSTRING], * neg[FKEY_NSTRING];
+	int i, k, o, ret, mpreds, nterms;
+	struct fcompiled * f;
+	sigset_t set, oset;
+
+	f = xmalloc( sizeof (struct fcompiled));
+	memset( f, 0, sizeof (struct fcompiled));
+	memset( pos, 0, sizeof (pos));
+	memset( neg, 0, sizeof (neg));
+	mpreds = nterms = 0;
+
+	buf = xmalloc( strlen( expr ? expr : "") + 1);
+	strcpy( buf, expr ? expr : "");
+
+	ret = 0;
+	for (term = strtok( buf, " \t\n"); term; term = strtok( NULL, " \t\n")) {
+		nterms++;
+
+		/* Split the term in key, operator and value */
+
+		for (i=0; isalpha( term[i]); i++);
+		for (k=0; fkeys[k].name; k++)
+			if ((strlen( fkeys[k].name) == i) &&
+					!strncasecmp( fkeys[k].name, term, i))
+				break;
+		if (!fkeys[k].name) {
+			snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad key: %.16s", term);
+			ret = 1;
+			break;
+		}
+		for (o=0; fops[o].str; o++)
+			if (!strncmp( fops[o].str, term+i, strlen( fops[o].str)))
+				break;
+		val = term + i + (fops[o].str ? strlen( fops[o].str) : 0);
+		if (!fops[o].str || !*val) {
+			snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad term: %.16s", term);
+			ret = 1;
+			break;
+		}
+		i = fkeys[k].key;
+		o = fops[o].op;
+
+		/* String keys go into the regex sets ... */
+
+		if (i < FKEY_NSTRING) {
+			f->level[i] = fkeys[k].level;
+			switch (o) {
+			case FOP_EQ:
+				pos[i] = filter_addpat( pos[i], val, 1);
+				break;
+			case FOP_MATCH:
+				pos[i] = filter_addpat( pos[i], val, 0);
+				break;
+			case FOP_NE:
+				neg[i] = filter_addpat( neg[i], val, 1);
+				break;
+			case FOP_NOMATCH:
+				neg[i] = filter_addpat( neg[i], val, 0);
+				break;
+			default:
+				snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad op: %.16s",
+						term);
+				ret = 1;
+				break;
+			}
+			if (ret)
+				break;
+			continue;
+		}
+
+		/* ... and numeric keys in the predicate chain. */
+
+		if ((o == FOP_MATCH) || (o == FOP_NOMATCH)) {
+			snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad op: %.16s", term);
+			ret = 1;
+			break;
+		}
+		if (f->npreds == mpreds)
+			f->preds = xrealloc( f->preds, (mpreds += 8) * sizeof
+					(struct fpred));
+		f->preds[f->npreds].key = i;
+		f->preds[f->npreds].op = o;
+		f->preds[f->npreds].level = fkeys[k].level;
+		f->preds[f->npreds].value = filter_value( val, &end);
+		if ((end == val) || *end) {
+			snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad value: %.16s",
+					term);
+			ret = 1;
+			break;
+		}
+		f->npreds++;
+	}
+
+	/* Compile the regex sets */
+
+	for (i=0; !ret && (i<FKEY_NSTRING); i++) {
+		if (pos[i]) {
+			if (regcomp( &f->pos[i], pos[i], REG_EXTENDED | REG_NOSUB)) {
+				snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad regex: %.16s",
+						pos[i]);
+				ret = 1;
+				break;
+			}
+			f->havepos[i] = 1;
+		}
+		if (neg[i]) {
+			if (regcomp( &f->neg[i], neg[i], REG_EXTENDED | REG_NOSUB)) {
+				snprintf( filter_errmsg, MSG_TEXT_SIZE, "Bad regex: %.16s",
+						neg[i]);
+				ret = 1;
+				break;
+			}
+			f->haveneg[i] = 1;
+		}
+	}
+	for (i=0; i<FKEY_NSTRING; i++) {
+		free( pos[i]);
+		free( neg[i]);
+	}
+
+	if (ret) {
+		filter_free( f);
+		free( buf);
+		return (1);
+	}
+
+	/* Install the new filter. The filter is used from the SIGALRM handler,
+	 * so block that signal while swapping. */
+
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+
+	filter_free( fc);
+	free( filter_expr);
+	if (nterms) {
+		fc = f;
+		filter_expr = xmalloc( strlen( expr) + 1);
+		strcpy( filter_expr, expr);
+	} else {
+		filter_free( f);
+		fc = NULL;
+		filter_expr = NULL;
+	}
+	for (i=0; i<procs_maxi; i++)
+		procs[i].filtered = 0;
+
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	free( buf);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * filter_match: Check process `p' against the terms of the current filter
+ * that can be evaluated at collection level `level'. This lets read_procs()
+ * skip the more expensive reads for processes that are filtered out
+ * early. Returns nonzero if the process passes. */
+
+int filter_match( struct process_info * p, int level)
+{
+	int i;
+	double v;
+	const char * s;
+	char state[2];
+	struct fpred * fp;
+
+	if (!fc)
+		return (1);
+
+	for (i=0; i<fc->npreds; i++) {
+		fp = fc->preds + i;
+		if (fp->level != level)
+			continue;
+		switch (fp->key) {
+		case FKEY_PID:
+			v = p->pid;
+			break;
+		case FKEY_UID:
+			v = p->uid;
+			break;
+		case FKEY_CPU:
+			v = p->pct_cpu;
+			break;
+		case FKEY_RSS:
+			v = p->rss;
+			break;
+		case FKEY_VSIZE:
+			v = p->vsize;
+			break;
+		case FKEY_PRIO:
+			v = p->priority;
+			break;
+		default:
+			v = 0;
+			break;
+		}
+		switch (fp->op) {
+		case FOP_EQ:
+			if (v != fp->value) return (0);
+			break;
+		case FOP_NE:
+			if (v == fp->value) return (0);
+			break;
+		case FOP_LT:
+			if (v >= fp->value) return (0);
+			break;
+		case FOP_LE:
+			if (v > fp->value) return (0);
+			break;
+		case FOP_GT:
+			if (v <= fp->value) return (0);
+			break;
+		case FOP_GE:
+			if (v < fp->value) return (0);
+			break;
+		}
+	}
+
+	for (i=0; i<FKEY_NSTRING; i++) {
+		if ((fc->level[i] != level) || !(fc->havepos[i] || fc->haveneg[i]))
+			continue;
+		switch (i) {
+		case FKEY_COMM:
+			s = p->comm;
+			break;
+		case FKEY_STATE:
+			state[0] = p->state; state[1] = '\000';
+			s = state;
+			break;
+		case FKEY_USER:
+			s = p->user;
+			break;
+		case FKEY_CMD:
+		default:
+			s = p->cmdline;
+			break;
+		}
+		if (fc->havepos[i] && regexec( &fc->pos[i], s, 0, NULL, 0))
+			return (0);
+		if (fc->haveneg[i] && !regexec( &fc->neg[i], s, 0, NULL, 0))
+			return (0);
+	}
+
+	return (1);
+}
@@ -0,0 +1,532 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * fs.c: Free space of the mounted filesystems. The statfs() calls are done
+ * by a small pool of worker threads, because statfs() on a hung network
+ * mount does not return. The update only queues probes and looks at the
+ * results of earlier ones; a probe that takes too long is reported, and
+ * its worker is replaced, up to FS_MAX_WORKERS workers. When all of them
+ * hang, no more probes are queued.
+ * The mount table is only read again when the kernel tells us, through
+ * poll() on /proc/self/mounts, that it has changed.
+ *
+ * The free space and free inodes of every mount are sampled into a ring
+ * of FS_WINDOW samples. A least-squares line through the ring gives the
+ * rate at which the filesystem fills up. The sums for the fit are updated
+ * when a sample enters or leaves the ring, so a sample costs O(1).
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int					nmounts			= 0;	/* # of entries in mount table */
+int					mounts_size		= 16;	/* initial mount table size	*/
+int					fs_workers		= 0;	/* # of running workers		*/
+int					fs_hung			= 0;	/* # of them that hang		*/
+int					fs_head			= 0;	/* probe queue: next to take */
+int					fs_tail			= 0;	/* probe queue: next free	*/
+int					fs_mountsfd		= -1;	/* open mount table			*/
+int					fs_polled		= 0;	/* It is a proc file		*/
+int					fs_bufsize		= 0;	/* size of fs_buf			*/
+int					fs_serial		= 0;	/* # of mount table reads	*/
+char *				fs_buf			= NULL;	/* mount table contents		*/
+struct stat			fs_stat;				/* mount table file status	*/
+
+struct mount_info **	mounts		= NULL;	/* mounted filesystems		*/
+struct mount_info *		fs_queue[FS_QUEUE_SIZE];	/* pending probes	*/
+
+pthread_mutex_t		fs_lock			= PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t		fs_cond			= PTHREAD_COND_INITIALIZER;
+
+/* Filesystem types that are checked, and those of them that are remote.
+ * These are lists of shell patterns. */
+
+char *	fsinclude	= "ext2 ext3 ext4 xfs btrfs f2fs zfs jfs reiserfs vfat "
+					  "exfat ntfs ntfs3 umsdos nfs nfs4 cifs smb3";
+char *	fsexclude	= "";
+char *	fsremote	= "nfs nfs4 cifs smb3 9p ceph glusterfs fuse.sshfs";
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void *		fs_worker			(void *);
+int			fs_spawn			(void);
+void		fs_unescape			(char *);
+int			fs_changed			(void);
+int			fs_read_mounts		(void);
+void		fs_sample			(struct mount_info *, double);
+void		fs_sum				(struct mount_info *, struct fs_sample *, int);
+int			fs_comp				(struct mount_info **, struct mount_info **);
+struct mount_info *	fs_lookup	(const char *, const char *, const char *);
+
+/* ------------------------------------------------------------------------
+ * fs_worker: Take probes from the queue and do them. The lock is not held
+ * during statfs(), so a hung probe only blocks this worker. A worker that
+ * was replaced while it hung exits when its probe returns, unless it is
+ * needed again. */
+
+void * fs_worker( void * arg)
+{
+	struct mount_info * m;
+	struct statfs f;
+	int ret;
+
+	pthread_mutex_lock( &fs_lock);
+	for (;;) {
+		while (fs_head == fs_tail)
+			pthread_cond_wait( &fs_cond, &fs_lock);
+		m = fs_queue[fs_head];
+		fs_head = (fs_head + 1) % FS_QUEUE_SIZE;
+		m->started = mono_time();
+		pthread_mutex_unlock( &fs_lock);
+
+		ret = statfs( m->mntpoint, &f);
+
+		pthread_mutex_lock( &fs_lock);
+		m->took = mono_time() - m->started;
+		m->started = 0;
+		m->pending = 0;
+
+		/* The mount is probed less often from the time a probe is late
+		 * until one returns in time */
+
+		m->late = 0;
+		if (m->took <= FS_DEADLINE)
+			m->interval = m->remote ? FS_REMOTE_INTERVAL : 0;
+		if (m->hung) {
+			m->hung = 0;
+			fs_hung--;
+		}
+		if (ret) {
+			m->err = errno;
+		} else {
+			m->err = 0;
+			m->valid = 1;
+			m->bsize = f.f_bsize;
+			m->blocks = f.f_blocks;
+			m->bfree = f.f_bfree;
+			m->bavail = f.f_bavail;
+			m->files = f.f_files;
+			m->ffree = f.f_ffree;
+			m->probed = mono_time();
+			fs_sample( m, m->probed);
+		}
+		if (m->gone) {
+			free( m->device);
+			free( m);
+		}
+		if (fs_workers - fs_hung > FS_WORKERS) {
+			fs_workers--;
+			pthread_mutex_unlock( &fs_lock);
+			return (NULL);
+		}
+	}
+	return (NULL);
+}
+
+/* ------------------------------------------------------------------------
+ * fs_spawn: Start a worker. The workers get no signals. Returns nonzero
+ * if the thread cannot be created. */
+
+int fs_spawn( void)
+{
+	sigset_t set, oset;
+	pthread_t tid;
+	int err;
+
+	sigfillset( &set);
+	pthread_sigmask( SIG_BLOCK, &set, &oset);
+	if ((err = pthread_create( &tid, NULL, fs_worker, NULL)))
+		queue_msg( MAX_PRIO, "pthread_create: %s", strerror( err));
+	else {
+		pthread_detach( tid);
+		fs_workers++;
+	}
+	pthread_sigmask( SIG_SETMASK, &oset, NULL);
+	return (err != 0);
+}
+
+/* ------------------------------------------------------------------------
+ * fs_sum: Add sample `s' to the least-squares sums of `m', or subtract it
+ * if `sign' is -1. Times and values are taken relative to the base sample,
+ * to keep the sums small. */
+
+void fs_sum( struct mount_info * m, struct fs_sample * s, int sign)
+{
+	double x, y, z;
+
+	x = s->t - m->base.t;
+	y = s->bfree - m->base.bfree;
+	z = s->ffree - m->base.ffree;
+	m->sx += sign * x;
+	m->sxx += sign * x * x;
+	m->sy += sign * y;
+	m->sxy += sign * x * y;
+	m->sz += sign * z;
+	m->sxz += sign * x * z;
+}
+
+/* ------------------------------------------------------------------------
+ * fs_sample: Add the result of a probe of `m' at time `now' to its ring
+ * of samples, at most one every FS_SAMPLE_INTERVAL seconds, and fit the
+ * fill rates and the time until the mount runs out of space and inodes.
+ * Every time the ring wraps, the sums are computed again from a new base,
+ * so that rounding errors do not add up. Called with fs_lock held. */
+
+void fs_sample( struct mount_info * m, double now)
+{
+	struct fs_sample * s;
+	double n, d;
+	int i;
+
+	if (m->nsamples && (now - m->last < FS_SAMPLE_INTERVAL))
+		return;
+	m->last = now;
+
+	s = m->samples + m->head;
+	if (m->nsamples == FS_WINDOW)
+		fs_sum( m, s, -1);
+	else
+		m->nsamples++;
+	s->t = now;
+	s->bfree = (double) m->bavail * m->bsize;
+	s->ffree = m->ffree;
+	if (m->nsamples == 1)
+		m->base = *s;
+	fs_sum( m, s, 1);
+
+	if (!(m->head = (m->head + 1) % FS_WINDOW)) {
+		m->base = m->samples[0];
+		m->sx = m->sxx = m->sy = m->sxy = m->sz = m->sxz = 0;
+		for (i=0; i<FS_WINDOW; i++)
+			fs_sum( m, m->samples + i, 1);
+	}
+
+	/* The slope of free space against time is minus the fill rate */
+
+	n = m->nsamples;
+	d = n * m->sxx - m->sx * m->sx;
+	if ((n < FS_MIN_SAMPLES) || (d <= 0)) {
+		m->rate = m->irate = m->eta = m->ieta = 0;
+		return;
+	}
+	m->rate = -(n * m->sxy - m->sx * m->sy) / d;
+	m->irate = -(n * m->sxz - m->sx * m->sz) / d;
+	m->eta = (m->rate > 0) ? s->bfree / m->rate : 0;
+	m->ieta = (m->irate > 0) && m->files ? s->ffree / m->irate : 0;
+}
+
+/* ------------------------------------------------------------------------
+ * fs_comp: Compare two mounts according to `fssort'. Mounts that do not
+ * fill up sort last by time to full. Used with qsort(). */
+
+int fs_comp( struct mount_info ** one, struct mount_info ** two)
+{
+	struct mount_info * a = *one, * b = *two;
+	double ea, eb;
+
+	switch (fssort) {
+	case FSSORT_GROWTH:
+		return ((a->rate < b->rate) - (a->rate > b->rate));
+	case FSSORT_ETA:
+		ea = a->eta ? a->eta : HUGE_VAL;
+		eb = b->eta ? b->eta : HUGE_VAL;
+		return ((ea > eb) - (ea < eb));
+	case FSSORT_USE:
+	default:
+		return ((fs_used( a) < fs_used( b)) - (fs_used( a) > fs_used( b)));
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * fs_used: Return the percentage of `m' that is used, as df(1) does. */
+
+double fs_used( struct mount_info * m)
+{
+	double used;
+
+	used = m->blocks - m->bfree;
+	if (!m->valid || (used + m->bavail <= 0))
+		return (0);
+	return (used * 100 / (used + m->bavail));
+}
+
+/* ------------------------------------------------------------------------
+ * fs_sort: Store the top `max' mounts in `top'. Returns the number of
+ * mounts stored. Must be called with fs_lock held. */
+
+int fs_sort( struct mount_info ** top, int max)
+{
+	int n;
+	struct mount_info ** all;
+
+	all = xmalloc( (nmounts + 1) * sizeof (struct mount_info *));
+	memcpy( all, mounts, nmounts * sizeof (struct mount_info *));
+	qsort( all, nmounts, sizeof (struct mount_info *),
+			(int (*)(const void *, const void *)) fs_comp);
+	n = (nmounts > max) ? max : nmounts;
+	memcpy( top, all, n * sizeof (struct mount_info *));
+	free( all);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * fs_init: Start the worker threads. They block all signals, so SIGALRM
+ * is always handled by the main thread. */
+
+int fs_init( void)
+{
+	mounts = xmalloc( mounts_size * sizeof (struct mount_info *));
+
+	while ((fs_workers < FS_WORKERS) && !fs_spawn());
+	if (!fs_workers)
+		fprintf( stderr, "fs: no worker threads\n");
+	return (!fs_workers);
+}
+
+/* ------------------------------------------------------------------------
+ * fs_unescape: Undo the octal escapes of /proc/mounts (\040 is a space). */
+
+void fs_unescape( char * s)
+{
+	char * d;
+
+	for (d=s; *s; d++)
+		if ((s[0] == '\\') && isdigit( s[1]) && isdigit( s[2]) &&
+				isdigit( s[3])) {
+			*d = (s[1]-'0') * 64 + (s[2]-'0') * 8 + (s[3]-'0');
+			s += 4;
+		} else
+			*d = *s++;
+	*d = '\000';
+}
+
+/* ------------------------------------------------------------------------
+ * fs_lookup: Find a mount in the mount table. Add it if it is new. Must
+ * be called with fs_lock held. */
+
+struct mount_info * fs_lookup( const char * device, const char * mntpoint,
+		const char * type)
+{
+	struct mount_info * m;
+	int i;
+
+	for (i=0; i<nmounts; i++)
+		if (!strcmp( mounts[i]->mntpoint, mntpoint) &&
+				!strcmp( mounts[i]->device, device))
+			return (mounts[i]);
+
+	if (nmounts == mounts_size)
+		mounts = xrealloc( mounts, (mounts_size *= 2) * sizeof
+				(struct mount_info *));
+	m = mounts[nmounts++] = xmalloc( sizeof (struct mount_info));
+	memset( m, 0, sizeof (struct mount_info));
+
+	/* The three strings share one allocation */
+
+	m->device = xmalloc( strlen( device) + strlen( mntpoint) +
+			strlen( type) + 3);
+	m->mntpoint = m->device + strlen( device) + 1;
+	m->type = m->mntpoint + strlen( mntpoint) + 1;
+	strcpy( m->device, device);
+	strcpy( m->mntpoint, mntpoint);
+	strcpy( m->type, type);
+	m->remote = match_list( fsremote, type);
+	m->interval = m->remote ? FS_REMOTE_INTERVAL : 0;
+	return (m);
+}
+
+/* ------------------------------------------------------------------------
+ * fs_changed: Return nonzero if the mount table must be read. The kernel
+ * flags a change of /proc/self/mounts with POLLPRI. If the file is not in
+ * a proc filesystem, as with a fixture, its modification time is used. */
+
+int fs_changed( void)
+{
+	char fname[FILENAME_MAX];
+	struct pollfd pfd;
+	struct statfs f;
+	struct stat st;
+
+	sprintf( fname, "%s/self/mounts", procroot);
+	if (fs_mountsfd == -1) {
+		if ((fs_mountsfd = open( fname, O_RDONLY)) == -1) {
+			queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+			return (0);
+		}
+		fs_polled = !fstatfs( fs_mountsfd, &f) &&
+				(f.f_type == PROC_SUPER_MAGIC);
+		fstat( fs_mountsfd, &fs_stat);
+		return (1);
+	}
+
+	if (fs_polled) {
+		pfd.fd = fs_mountsfd;
+		pfd.events = POLLPRI;
+		pfd.revents = 0;
+		return ((poll( &pfd, 1, 0) > 0) && 
+				(pfd.revents & (POLLPRI | POLLERR)));
+	}
+
+	if (stat( fname, &st) || ((st.st_mtime == fs_stat.st_mtime) &&
+			(st.st_size == fs_stat.st_size) && 
+			(st.st_ino == fs_stat.st_ino)))
+		return (0);
+	close( fs_mountsfd);
+	fs_mountsfd = -1;
+	return (fs_changed());
+}
+
+/* ------------------------------------------------------------------------
+ * fs_read_mounts: Read the mount table and update the table of checked
+ * mounts. Must be called with fs_lock held. */
+
+int fs_read_mounts( void)
+{
+	char device[FILENAME_MAX], mntpoint[FILENAME_MAX];
+	char type[1024], rw[1024];
+	char * p, * q;
+	int i, n, len;
+	struct mount_info * m;
+
+	if (!fs_buf)
+		fs_buf = xmalloc( fs_bufsize = BUFSIZ);
+	lseek( fs_mountsfd, 0, SEEK_SET);
+	for (len=0; (n = read( fs_mountsfd, fs_buf+len, fs_bufsize-len-1)) > 0;)
+		if ((len += n) == fs_bufsize-1)
+			fs_buf = xrealloc( fs_buf, fs_bufsize *= 2);
+	if (n == -1) {
+		queue_msg( MAX_PRIO, "mounts: %s", strerror( errno));
+		return (1);
+	}
+	fs_buf[len] = '\000';
+
+	fs_serial++;
+	for (p=fs_buf; *p; p=q) {
+		if ((q = strchr( p, '\n')))
+			*q++ = '\000';
+		else
+			q = p + strlen( p);
+		if (sscanf( p, "%4095s %4095s %1023s %1023s", device, mntpoint, 
+				type, rw) != 4)
+			continue;
+		if (!match_list( fsinclude, type) || match_list( fsexclude, type))
+			continue;
+		if (!strncmp( rw, "ro", 2))
+			continue;
+		fs_unescape( mntpoint);
+		m = fs_lookup( device, mntpoint, type);
+		m->serial = fs_serial;
+	}
+
+	/* Remove unmounted filesystems. A worker that is still probing one
+	 * frees it when it is done. */
+
+	for (i=0; i<nmounts; i++) {
+		if (mounts[i]->serial == fs_serial)
+			continue;
+		m = mounts[i];
+		mounts[i--] = mounts[--nmounts];
+		if (m->pending)
+			m->gone = 1;
+		else {
+			free( m->device);
+			free( m);
+		}
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * check_diskfree: Check mounted filesystems for free diskspace. Give a
+ * message if a filesystem is getting full, will be full or out of inodes
+ * within FS_ALERT_ETA seconds, or if a probe of it is taking longer than
+ * FS_DEADLINE seconds. Local filesystems are probed every call, which
+ * is the period of the diskfree source, remote ones every
+ * FS_REMOTE_INTERVAL seconds. A mount that does
+ * not respond is probed less often, up to every FS_MAX_INTERVAL seconds,
+ * and the worker that hangs on it is replaced. */
+
+int check_diskfree( void)
+{
+	int i, full;
+	double now, age;
+	struct mount_info * m;
+
+	/* /proc/mounts is available since kernel version 1.3.64 */
+
+	if (version_code < 1003064)
+		return (0);
+
+	now = mono_time();
+	full = 0;
+	pthread_mutex_lock( &fs_lock);
+	if (fs_changed())
+		fs_read_mounts();
+
+	for (i=0; i<nmounts; i++) {
+		m = mounts[i];
+
+		/* Report a probe that is overdue. The first time, the mount is
+		 * probed less often from now on, and if the probe is running, a
+		 * new worker takes over from the one that hangs on it. */
+
+		if (m->pending && ((age = now - m->queued) > FS_DEADLINE)) {
+			queue_msg( MED_PRIO, "%.11s no reply %ds", m->mntpoint,
+					(int) age);
+			if (!m->late) {
+				m->late = 1;
+				m->interval = m->interval ? m->interval * 2 :
+						FS_REMOTE_INTERVAL;
+				if (m->interval > FS_MAX_INTERVAL)
+					m->interval = FS_MAX_INTERVAL;
+			}
+			if (m->started && (now - m->started > FS_DEADLINE) && 
+					!m->hung) {
+				m->hung = 1;
+				fs_hung++;
+				if (fs_workers < FS_MAX_WORKERS)
+					fs_spawn();
+			}
+		}
+
+		if (m->valid && (m->bavail < (min_diskfree/m->bsize))) {
+			queue_msg( MED_PRIO, "%.18s is FULL!!", m->mntpoint);
+			full = 1;
+		} else if (m->valid && m->files && !m->ffree) {
+			queue_msg( MED_PRIO, "%.12s no inodes", m->mntpoint);
+			full = 1;
+		} else if (m->eta && (m->eta < FS_ALERT_ETA)) {
+			queue_msg( MED_PRIO, "%.12s full in %dm", m->mntpoint,
+					(int) (m->eta / 60) + 1);
+			full = 1;
+		} else if (m->ieta && (m->ieta < FS_ALERT_ETA)) {
+			queue_msg( MED_PRIO, "%.9s inodes in %dm", m->mntpoint,
+					(int) (m->ieta / 60) + 1);
+			full = 1;
+		}
+
+		if (m->pending || (now < m->next) || (fs_hung == fs_workers))
+			continue;
+		if ((fs_tail + 1) % FS_QUEUE_SIZE == fs_head)
+			continue;
+		m->pending = 1;
+		m->queued = now;
+		m->next = now + m->interval;
+		fs_queue[fs_tail] = m;
+		fs_tail = (fs_tail + 1) % FS_QUEUE_SIZE;
+		pthread_cond_signal( &fs_cond);
+	}
+	if (fs_hung == fs_workers)
+		queue_msg( MED_PRIO, "All %d fs probes hang", fs_workers);
+	pthread_mutex_unlock( &fs_lock);
+
+	if (!full)
+		queue_msg( MIN_PRIO, "No filesystems are full");
+
+	return (0);
+}
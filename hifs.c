@@ -42,20 +42,51 @@ char *			version_string;
 /* Defaults */
 
 double			delay		= 5;
+double			budget		= 0;	/* CPU budget in %, 0 is a fixed delay */
+double			period		= 0;	/* The update period in effect */
+int				alarm_set	= 0;	/* The SIGALRM handler is in place */
 int				sort		= SORT_CPU;
 int				memory		= MEM_FREE;
 int				info		= INFO_NAME;
+int				page		= PAGE_PROCS;
+int				cgsort		= CGSORT_CPU;
+int				fssort		= FSSORT_USE;
+int				disksort	= DISKSORT_UTIL;
+int				netsort		= NETSORT_BYTES;
+int				socksort	= SOCKSORT_FILL;
+int				histmode	= HISTMODE_CPU_1S;
+int				aggrsort	= AGGSORT_CPU;
+int				treesort	= TREESORT_CPU;
+int				threadsort	= THREADSORT_CPU;
 char *			mapfile		= "";
+char *			procroot	= "/proc";
+char *			utmpfile	= _PATH_UTMP;
 
 int				min_diskfree	= 1000000;
+int				majflt_warn	= 0;	/* Major faults/s to highlight at */
 int				debug		= 0;
+int				bench		= 0;	/* # of benchmark ticks to run */
+char *			bench_cmd	= NULL;	/* Command to run between them */
+int				profile		= 0;	/* Show the profile overlay */
 
 /* Tables for string representations of sort/info/mem modes */
 
 struct mode sortmodes[] = {
 	{ "By CPU", "CPU" },
 	{ "By RSS", "RSS" },
-	{ "By Vsize", "VSZ" }
+	{ "By Vsize", "VSZ" },
+	{ "By I/O read", "IOR" },
+	{ "By I/O write", "IOW" },
+	{ "By PSS", "PSS" },
+	{ "By USS", "USS" },
+	{ "By CPU, 1 minute", "C1M" },
+	{ "By CPU, 5 minutes", "C5M" },
+	{ "By CPU, 15 minutes", "C15" },
+	{ "By Run queue wait", "RQW" },
+	{ "By Block I/O delay", "BIO" },
+	{ "By Major faults", "MAJ" },
+	{ "By Minor faults", "MIN" },
+	{ "By Ctx switches", "CSW" }
 };
 
 struct mode infomodes[] = {
@@ -63,7 +94,10 @@ struct mode infomodes[] = {
 	{ "Command Line", "CMD" },
 	{ "Wchan", "WCH" },
 	{ "Username", "NAM" },
-	{ "Priority", "PRI" }
+	{ "Priority", "PRI" },
+	{ "I/O read/write", "I/O" },
+	{ "Faults maj/min", "FLT" },
+	{ "Ctx switches vol/inv", "CSW" }
 };
 
 struct mode memmodes[] = {
@@ -71,15 +105,93 @@ struct mode memmodes[] = {
 	{ "Used (Kb)", "USD" }
 };
 
+struct mode pagemodes[] = {
+	{ "Processes", "PRC" },
+	{ "Cgroups", "CGR" },
+	{ "Filesystems", "MNT" },
+	{ "Disks", "DSK" },
+	{ "Network", "NET" },
+	{ "Sockets", "SCK" },
+	{ "Pressure", "PSI" },
+	{ "Kernel events", "EVT" },
+	{ "History", "HIS" },
+	{ "Users", "USR" },
+	{ "Groups", "GRP" },
+	{ "Sessions", "SES" },
+	{ "Process tree", "TRE" },
+	{ "Threads", "THR" }
+};
+
+struct mode cgsortmodes[] = {
+	{ "By CPU", "CPU" },
+	{ "By Memory", "MEM" },
+	{ "By I/O", "I/O" },
+	{ "By Pids", "PID" }
+};
+
+struct mode fssortmodes[] = {
+	{ "By Usage", "USE" },
+	{ "By Growth", "GRO" },
+	{ "By Time to full", "ETA" }
+};
+
+struct mode disksortmodes[] = {
+	{ "By Utilisation", "UTL" },
+	{ "By IOPS", "IOP" },
+	{ "By Throughput", "B/S" },
+	{ "By Await", "AWT" },
+	{ "By Queue", "QUE" }
+};
+
+struct mode netsortmodes[] = {
+	{ "By Throughput", "B/S" },
+	{ "By Packets", "PKT" },
+	{ "By Drops", "DRP" }
+};
+
+struct mode socksortmodes[] = {
+	{ "By Queue fill", "FIL" },
+	{ "By Queue length", "QUE" },
+	{ "By Port", "PRT" }
+};
+
+struct mode histmodes[] = {
+	{ "CPU, 10 minutes", "C10" },
+	{ "CPU, 6 hours", "C6H" },
+	{ "CPU, 7 days", "C7D" },
+	{ "RSS, 10 minutes", "R10" },
+	{ "RSS, 6 hours", "R6H" },
+	{ "RSS, 7 days", "R7D" }
+};
+
+struct mode aggrsortmodes[] = {
+	{ "By CPU", "CPU" },
+	{ "By RSS", "RSS" },
+	{ "By I/O", "I/O" },
+	{ "By Processes", "PRC" }
+};
+
+struct mode treesortmodes[] = {
+	{ "By CPU", "CPU" },
+	{ "By RSS", "RSS" }
+};
+
+struct mode threadsortmodes[] = {
+	{ "By CPU", "CPU" },
+	{ "By CPU time", "TIM" },
+	{ "By Thread id", "TID" }
+};
+
 
 /* ------------------------------------------------------------------------
  * Prototypes not in hifs.h. */
 
 void 		gracefull_exit	(int);
 int			cfgfile			(void);
-void		set_update		(double);
 void		print_banner	(void);
 void		print_help		(void);
+void		toggle_mode		(int *, int, struct mode *, const char *);
+int			run_bench		(void);
 
 /* ------------------------------------------------------------------------
  * cfgfile: Parse the configfile */
@@ -121,6 +233,8 @@ void set_update( double update)
 {
 	struct itimerval it;
 
+	period = update;
+
 	it.it_interval.tv_sec = update;
 	it.it_interval.tv_usec = (update - floor( update)) * 1e6;
 	it.it_value.tv_sec = update;
@@ -128,6 +242,54 @@ void set_update( double update)
 	setitimer( ITIMER_REAL, &it, NULL);
 }
 	
+/* ------------------------------------------------------------------------
+ * adapt_period: In budget mode, set the update period so that hifs uses
+ * `budget' percent of one CPU. The cost of an update is the CPU time used
+ * since the previous one, screen updates included. It is averaged, so that
+ * a single slow update does not stretch the period. Called from
+ * proc_update(). The updates of the initialisation only choose a period,
+ * as there is no SIGALRM handler yet to take the timer. */
+
+void adapt_period( void)
+{
+	double cpu, want;
+
+	static double last_cpu = -1, cost = 0;
+
+	cpu = self_time();
+	if (last_cpu < 0) {
+		last_cpu = cpu;
+		return;
+	}
+	if (cost)
+		cost += (cpu - last_cpu - cost) * BUDGET_WEIGHT;
+	else
+		cost = cpu - last_cpu;
+	last_cpu = cpu;
+
+	want = cost * 100 / budget;
+	if (want < BUDGET_MIN_PERIOD)
+		want = BUDGET_MIN_PERIOD;
+	if (want > BUDGET_MAX_PERIOD)
+		want = BUDGET_MAX_PERIOD;
+	if (!alarm_set)
+		period = want;
+	else if (fabs( want - period) > period * BUDGET_SLACK)
+		set_update( want);
+}
+
+/* ------------------------------------------------------------------------
+ * toggle_mode: Advance `*mode' to the next mode of `modes', wrapping
+ * around after `last', and tell the user. */
+
+void toggle_mode( int * mode, int last, struct mode * modes, const char * what)
+{
+	(*mode)++;
+	if (*mode > last)
+		*mode = 0;
+	queue_msg( MIN_PRIO, "%s: %s", what, modes[*mode].l);
+}
+
 /* ------------------------------------------------------------------------
  * gracefull_exit: This is the sig-go-away handler. */
 
@@ -159,10 +321,64 @@ void print_help( void)
 	printf( "  -v, --version        show version information\n");
 	printf( "  -h, --help           show this help\n");
 	printf( "  -d, --debug          set debug mode\n");
+	printf( "  -r, --root DIR       read process data from DIR, not /proc\n");
+	printf( "  -u, --utmp FILE      read logins from FILE\n");
+	printf( "  -b, --bench TICKS    time TICKS updates and print the results\n");
+	printf( "      --bench-cmd CMD  run CMD before each benchmark update\n");
 	printf( "\n");
 	return;
 }
 
+/* ------------------------------------------------------------------------
+ * run_bench: Run `bench' data and screen updates and print the time taken
+ * per stage, one line per stage in key=value form. The first update fills
+ * the process table and is not counted. */
+
+int run_bench( void)
+{
+	int i, nprocs;
+	long sc;
+	double cpu;
+
+	if (screen_init( 0))
+		return (1);
+	proc_update( 0);
+	screen_update();
+	prof_reset();
+	cpu = self_time();
+	sc = read_rwcalls();
+
+	for (i=0; i<bench; i++) {
+		if (bench_cmd && system( bench_cmd)) {
+			screen_close();
+			fprintf( stderr, "%s: failed\n", bench_cmd);
+			return (1);
+		}
+		proc_update( 0);
+		prof_begin( STAGE_RENDER); screen_update(); prof_end( STAGE_RENDER);
+	}
+	prof_tick( 0);			/* Account the last render */
+	cpu = self_time() - cpu;
+	sc = read_rwcalls() - sc;
+	screen_close();
+
+	for (i=nprocs=0; i<procs_maxi; i++)
+		if (procs[i].pid)
+			nprocs++;
+	for (i=0; i<NSTAGES; i++) {
+		if (!stages[i].n)
+			continue;
+		printf( "procs=%d stage=%s n=%lu mean_us=%.1f p50_us=%lu p90_us=%lu "
+				"p99_us=%lu max_us=%lu\n", nprocs, stages[i].name,
+				stages[i].n, stages[i].total / stages[i].n * 1e6,
+				prof_percentile( i, 50), prof_percentile( i, 90),
+				prof_percentile( i, 99), stages[i].max);
+	}
+	printf( "procs=%d stage=self n=%d cpu_us=%.1f rw_calls=%ld\n", nprocs,
+			bench, cpu * 1e6 / bench, sc / bench);
+	return (0);
+}
+
 /* ------------------------------------------------------------------------
  * main: This is hifs. */
 
@@ -170,7 +386,7 @@ int main( int argc, char ** argv)
 {
 	char buf[BUFSIZ];
 	char c, * ptr;
-	int i, done, optindex; 
+	int i, key, done, optindex; 
 	int major, minor, patchlevel;
 	struct sigaction sa;
 	struct termios tioold, tionew;
@@ -181,7 +397,12 @@ int main( int argc, char ** argv)
 	struct option opts[] = {
 		{ "version", 0, 0, 'v' },
 		{ "help", 0, 0, 'h' },
-		{ "debug", 0, 0, 'd'}
+		{ "debug", 0, 0, 'd' },
+		{ "root", 1, 0, 'r' },
+		{ "utmp", 1, 0, 'u' },
+		{ "bench", 1, 0, 'b' },
+		{ "bench-cmd", 1, 0, 'B' },
+		{ 0, 0, 0, 0 }
 	};
 
 #ifdef CONFIG_SU
@@ -250,7 +471,8 @@ int main( int argc, char ** argv)
 
 	/* Parse command-line arguments */
 	
-	while ((c = getopt_long( argc, argv, "vhd", opts, &optindex)) != EOF) {
+	while ((c = getopt_long( argc, argv, "vhdr:u:b:", opts, &optindex)) 
+			!= EOF) {
 		switch (c) {
 		case 'v':
 			print_banner();
@@ -261,6 +483,18 @@ int main( int argc, char ** argv)
 		case 'd':
 			debug = 1;
 			break;
+		case 'r':
+			procroot = optarg;
+			break;
+		case 'u':
+			utmpfile = optarg;
+			break;
+		case 'b':
+			bench = atoi( optarg);
+			break;
+		case 'B':
+			bench_cmd = optarg;
+			break;
 		case '?':
 			printf( "Try `hifs --help' for more information.\n");
 			exit( 1);
@@ -281,9 +515,9 @@ int main( int argc, char ** argv)
 	version_string = xmalloc( sizeof( ut.release) + 1);
 	strcpy( version_string, ut.release);
 
-	/* Parse the configfile */
+	/* Parse the configfile. A benchmark runs with the defaults. */
 
-	if (cfgfile()) {
+	if (!bench && cfgfile()) {
 		fprintf( stderr, "Failed to read the configfile\n");
 		exit( 1);
 	}
@@ -294,6 +528,9 @@ int main( int argc, char ** argv)
 		exit( 1);
 	}
 
+	if (bench)
+		exit( run_bench());
+
 	/* We make our tty mode 0600 to prevent talk's and write's to this
 	 * window. */
 
@@ -368,10 +605,12 @@ int main( int argc, char ** argv)
 	sigaction( SIGTERM, &sa, NULL);
 	sa.sa_handler = proc_update;
 	sigaction( SIGALRM, &sa, NULL);
+	alarm_set = 1;
 
-	/* Set updating frequency */
+	/* Set updating frequency. In budget mode, the updates above have
+	 * already chosen one. */
 
-	set_update( delay);
+	set_update( (budget > 0) && period ? period : delay);
 
 	/* Create a signal set to block SIGALRM later on */
 
@@ -387,27 +626,78 @@ int main( int argc, char ** argv)
 		 * update while reading this data. */
 
 		sigprocmask( SIG_BLOCK, &sigset, NULL);
-		screen_update();
+		prof_begin( STAGE_RENDER); screen_update(); prof_end( STAGE_RENDER);
 		sigprocmask( SIG_UNBLOCK, &sigset, NULL);
 
-		switch (xgetch( BIG_SLEEP, 0)) {
+		switch (key = xgetch( BIG_SLEEP, 0)) {
 			case 's': case ' ':
-				sort++;
-				if (sort > SORT_LAST)
-					sort = 0;
-				queue_msg( MIN_PRIO, "Sort mode: %s", sortmodes[sort].l);
+				switch (page) {
+				case PAGE_CGROUPS:
+					toggle_mode( &cgsort, CGSORT_LAST, cgsortmodes,
+							"Sort mode");
+					break;
+				case PAGE_MOUNTS:
+					toggle_mode( &fssort, FSSORT_LAST, fssortmodes,
+							"Sort mode");
+					break;
+				case PAGE_DISKS:
+					toggle_mode( &disksort, DISKSORT_LAST, disksortmodes,
+							"Sort mode");
+					break;
+				case PAGE_NET:
+					toggle_mode( &netsort, NETSORT_LAST, netsortmodes,
+							"Sort mode");
+					break;
+				case PAGE_SOCK:
+					toggle_mode( &socksort, SOCKSORT_LAST, socksortmodes,
+							"Sort mode");
+					break;
+				case PAGE_USERS:
+				case PAGE_GROUPS:
+				case PAGE_SESSIONS:
+					toggle_mode( &aggrsort, AGGSORT_LAST, aggrsortmodes,
+							"Sort mode");
+					break;
+				case PAGE_TREE:
+					toggle_mode( &treesort, TREESORT_LAST, treesortmodes,
+							"Sort mode");
+					break;
+				case PAGE_THREADS:
+					toggle_mode( &threadsort, THREADSORT_LAST, 
+							threadsortmodes, "Sort mode");
+					break;
+				case PAGE_HIST:
+					toggle_mode( &histmode, HISTMODE_LAST, histmodes,
+							"History");
+					break;
+				default:
+					toggle_mode( &sort, SORT_LAST, sortmodes, "Sort mode");
+					break;
+				}
 				break;
 			case 'i':
-				info++;
-				if (info > INFO_LAST)
-					info = 0;
-				queue_msg( MIN_PRIO, "Info mode: %s", infomodes[info].l);
+				toggle_mode( &info, INFO_LAST, infomodes, "Info mode");
 				break;
 			case 'm':
-				memory++;
-				if (memory > MEM_LAST)
-					memory = 0;
-				queue_msg( MIN_PRIO, "Mem mode: %s", memmodes[memory].l);
+				toggle_mode( &memory, MEM_LAST, memmodes, "Mem mode");
+				break;
+			case 'v':
+				toggle_mode( &page, PAGE_LAST, pagemodes, "Page");
+				if (page == PAGE_SOCK)
+					source_due( "sockets");
+				break;
+			case 'D':
+				profile = !profile;
+				screen_setup();
+				break;
+			case 'f':
+				ptr = get_string( "filter", 0);
+				if (filter_set( ptr))
+					notice( "%s", filter_errmsg);
+				else if (filter_expr)
+					notice( "Filter set");
+				else
+					notice( "Filter cleared");
 				break;
 			case 'k':
 				let_user_kill( KILL_NICE);
@@ -418,6 +708,19 @@ int main( int argc, char ** argv)
 			case 'w':
 				let_user_write();
 				break;
+			case 'c':
+				if (page == PAGE_TREE)
+					let_user_collapse();
+				break;
+			case 'W':
+				let_user_watch();
+				break;
+			case 't':
+				if (page == PAGE_THREADS)
+					page = PAGE_PROCS;
+				else
+					let_user_threads();
+				break;
 			case 'p':
 				let_user_renice();
 				break;
@@ -426,6 +729,7 @@ int main( int argc, char ** argv)
 				if (!ptr)
 					break;
 				if (sscanf( ptr, "%lf", &delay)) {
+					budget = 0;
 					set_update( delay);
 					notice( "Update now %.2f s", delay);
 				} else
@@ -471,6 +775,23 @@ int main( int argc, char ** argv)
 				break;
 #endif 	/* CONFIG_SU */
 
+			case KEY_UP: case KEY_DOWN: case KEY_PPAGE: case KEY_NPAGE:
+				if (page != PAGE_EVENTS)
+					break;
+				kmsg_scroll( key == KEY_UP ? -1 : key == KEY_DOWN ? 1 :
+						key == KEY_PPAGE ? -MAX_SHOWPROCESSES : 
+						MAX_SHOWPROCESSES);
+				break;
+			case XGETCH_WAKE:
+				kmsg_check();
+				thread_wake();
+				watch_wake();
+				if (psi_wake()) {
+					sigprocmask( SIG_BLOCK, &sigset, NULL);
+					proc_update( 0);
+					sigprocmask( SIG_UNBLOCK, &sigset, NULL);
+				}
+				break;
 			case 'q':
 				done = 1;
 			default:
@@ -28,6 +28,8 @@
 #include <sys/resource.h>
 #include <sys/param.h>
 #include <sys/utsname.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,6 +50,16 @@
 #include <paths.h>
 #include <math.h>
 #include <getopt.h>
+#include <regex.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fnmatch.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <linux/inet_diag.h>
 
 #if defined (HAVE_NCURSES_H)
 #include <ncurses.h>
@@ -68,14 +80,29 @@
 #define SORT_CPU 			0
 #define SORT_RSS 			1
 #define SORT_VSIZE			2
-#define SORT_LAST			2
+#define SORT_IO_READ		3
+#define SORT_IO_WRITE		4
+#define SORT_PSS			5
+#define SORT_USS			6
+#define SORT_CPU_1M			7	/* CPU over a window, see window.c */
+#define SORT_CPU_5M			8
+#define SORT_CPU_15M		9
+#define SORT_RUNQ			10	/* Run queue wait, from schedstat */
+#define SORT_BLKIO			11	/* Block I/O delay, from stat */
+#define SORT_MAJFLT			12	/* Fault rates, from stat */
+#define SORT_MINFLT			13
+#define SORT_CSW			14	/* Context switch rate, from status */
+#define SORT_LAST			14
 
 #define INFO_PID			0
 #define INFO_CMDLINE		1
 #define INFO_WCHAN			2
 #define INFO_NAME			3
 #define INFO_PRIO			4
-#define INFO_LAST			4
+#define INFO_IO				5
+#define INFO_FAULTS			6
+#define INFO_CSW			7
+#define INFO_LAST			7
 
 #define KILL_NICE			0
 #define KILL_BRUTE			1
@@ -84,6 +111,115 @@
 #define MEM_USED			1
 #define MEM_LAST			1
 
+#define PAGE_PROCS			0
+#define PAGE_CGROUPS		1
+#define PAGE_MOUNTS			2
+#define PAGE_DISKS			3
+#define PAGE_NET			4
+#define PAGE_SOCK			5
+#define PAGE_PSI			6
+#define PAGE_EVENTS			7
+#define PAGE_HIST			8
+#define PAGE_USERS			9
+#define PAGE_GROUPS			10
+#define PAGE_SESSIONS		11
+#define PAGE_TREE			12
+#define PAGE_THREADS		13
+#define PAGE_LAST			13
+
+#define CGSORT_CPU			0
+#define CGSORT_MEM			1
+#define CGSORT_IO			2
+#define CGSORT_PIDS			3
+#define CGSORT_LAST			3
+
+#define FSSORT_USE			0
+#define FSSORT_GROWTH		1
+#define FSSORT_ETA			2
+#define FSSORT_LAST			2
+
+#define DISKSORT_UTIL		0
+#define DISKSORT_IOPS		1
+#define DISKSORT_BYTES		2
+#define DISKSORT_AWAIT		3
+#define DISKSORT_QUEUE		4
+#define DISKSORT_LAST		4
+
+#define NETSORT_BYTES		0
+#define NETSORT_PACKETS		1
+#define NETSORT_DROPS		2
+#define NETSORT_LAST		2
+
+#define SOCKSORT_FILL		0
+#define SOCKSORT_QUEUE		1
+#define SOCKSORT_PORT		2
+#define SOCKSORT_LAST		2
+
+#define HISTMODE_CPU_1S		0	/* Tier, and what the processes show */
+#define HISTMODE_CPU_10S	1
+#define HISTMODE_CPU_1M		2
+#define HISTMODE_RSS_1S		3
+#define HISTMODE_RSS_10S	4
+#define HISTMODE_RSS_1M		5
+#define HISTMODE_LAST		5
+
+#define AGGSORT_CPU			0
+#define AGGSORT_RSS			1
+#define AGGSORT_IO			2
+#define AGGSORT_PROCS		3
+#define AGGSORT_LAST		3
+
+#define TREESORT_CPU		0
+#define TREESORT_RSS		1
+#define TREESORT_LAST		1
+
+#define THREADSORT_CPU		0
+#define THREADSORT_TIME		1
+#define THREADSORT_TID		2
+#define THREADSORT_LAST		2
+
+/* The stages of an update, for profiling */
+
+#define STAGE_JIFFIES		0
+#define STAGE_PROCS			1
+#define STAGE_READDIR		2	/* Sub stages of read_procs()	*/
+#define STAGE_STAT			3
+#define STAGE_STATUS		4
+#define STAGE_CMDLINE		5
+#define STAGE_GETPWUID		6
+#define STAGE_SCHED			7
+#define STAGE_CGMEMBER		8
+#define STAGE_PROCIO		9
+#define STAGE_PROCPSS		10
+#define STAGE_PROCSCHED		11
+#define STAGE_CGROUPS		12
+#define STAGE_CPU			13
+#define STAGE_SCHEDSTAT		14
+#define STAGE_LOADS			15
+#define STAGE_MEM			16
+#define STAGE_LOGINS		17
+#define STAGE_DISKFREE		18
+#define STAGE_DISKS			19
+#define STAGE_NET			20
+#define STAGE_SOCK			21
+#define STAGE_PSI			22
+#define STAGE_HIST			23
+#define STAGE_SORT			24
+#define STAGE_RENDER		25
+#define NSTAGES				26
+
+/* Stage histograms: LAT_SUB buckets of 1 usec, then LAT_SUB/2 buckets
+ * for every power of two up to 2^LAT_MAXBIT usec. */
+
+#define LAT_SUBBITS			5
+#define LAT_SUB				(1 << LAT_SUBBITS)
+#define LAT_MAXBIT			31
+#define LAT_BUCKETS			(LAT_SUB + (LAT_MAXBIT-LAT_SUBBITS+1)*LAT_SUB/2)
+
+#define FILTER_STAT			0	/* Filter levels: values from stat	*/
+#define FILTER_STATUS		1	/* from status					*/
+#define FILTER_CMDLINE		2	/* from cmdline					*/
+
 /* The cpu usage that we show is a weighted average over the usage during the
  * last three periods. We take an exponential decay for the weighting factors. 
  * The factors are normalized at 100 (%) */
@@ -105,6 +241,7 @@
 #define MAX_GROUPMEMBERS	8
 #define MAX_HOSTNAME		8
 #define MAX_SHOWPROCESSES	12
+#define PID_HASH_SIZE		16384	/* Must be a power of two */
 
 /* Screen related constants */
 
@@ -116,10 +253,46 @@
 #define STAT_LOGGEDIN		2
 
 #define DEF_TIMEOUT 		30	
+#define IO_BUDGET			0.01	/* Seconds per update for /proc/<pid>/io */
+#define SCHED_BUDGET		0.01	/* and for /proc/<pid>/schedstat */
+#define PSS_BUDGET			0.02	/* Seconds per update for smaps_rollup */
 #define BIG_SLEEP			1000
+#define MAX_WAKE			8		/* # of wake descriptors for xgetch() */
+#define XGETCH_WAKE			-2		/* xgetch() was woken by one of them */
+
+/* Budget mode: limits of the update period, the weight of the last update
+ * in the cost average, and the change in period that is worth a new timer */
+
+#define BUDGET_MIN_PERIOD	1.0
+#define BUDGET_MAX_PERIOD	60.0
+#define BUDGET_WEIGHT		0.25
+#define BUDGET_SLACK		0.1
 
 #define EMPTY "                          "
 
+/* Filesystem probes: # of worker threads, and the most there may be with
+ * the replacements of hung ones, queue size, the time after which a probe
+ * is reported, and the probe intervals of remote filesystems. */
+
+#define FS_WORKERS			4
+#define FS_MAX_WORKERS		16
+#define FS_QUEUE_SIZE		256
+#define FS_DEADLINE			5
+#define FS_REMOTE_INTERVAL	30
+#define FS_MAX_INTERVAL		300
+
+/* Fill rate: the samples in the fit, the minimum time between samples,
+ * the samples needed for a fit and the time to full that is reported */
+
+#define FS_WINDOW			64
+#define FS_SAMPLE_INTERVAL	30
+#define FS_MIN_SAMPLES		4
+#define FS_ALERT_ETA		3600
+
+#ifndef PROC_SUPER_MAGIC
+#define PROC_SUPER_MAGIC	0x9fa0
+#endif
+
 /* The geometry of the window */
 
 #define X_TITLE				0
@@ -150,6 +323,8 @@
 #define Y_CPUI				2
 #define X_GROUP				18
 #define Y_GROUP				6
+#define X_RUNQ				0
+#define Y_RUNQ				6		/* Below the groups, if there is room */
 #define X_PROCESSES_1		0
 #define X_PROCESSES_2		9
 #define X_PROCESSES_3		17
@@ -165,73 +340,6 @@
 #define CTRL(c) ((c)&31)
 #endif
 
-/* Definitions from proc.c */
-
-extern struct cpu_info			cpu;		/* CPU state info		*/
-extern struct mem_info			mem;		/* Memory info			*/
-extern struct utmp *			logins;		/* utmp array			*/
-extern struct process_info *	procs;		/* process table		*/
-extern double 					loads[];	/* load averages		*/
-
-extern int nlogins;			/* # of entries in utmp 				*/
-
-extern int procs_maxi;		/* Max index in process table			*/
-
-int 		proc_init			(void);
-void 		proc_update			(int);
-void		proc_close			(void);
-
-/* Definitions from screen.c: */
-
-int			screen_init			(int);
-void		screen_setup		(void);
-void 		screen_update		(void);
-void		screen_close		(void);
-void		show_help			(void);
-
-void		let_user_kill		(int);
-void		let_user_write		(void);
-void		let_user_renice		(void);
-
-char *		get_string			(const char *, char);
-void		queue_msg			(int, const char *, ...);
-void		notice				(const char *, ...);
-void		xsleep				(int);
-int			xgetch				(int,int);
-
-extern int nmessages;		/* # of messages in message queue		*/
-
-extern struct msg_entry *		messages;	/* message queue		*/
-
-/* Definitions from util.c: */
-
-void *		xmalloc( size_t);
-void *		xrealloc( void *, size_t);
-char *		strnzcpy( char *, const char *, size_t);
-
-/* Definitions from hifs.c: */
-
-extern int			memory;
-extern int			info;
-extern int			sort;
-extern int			min_diskfree;
-
-extern int			warned;
-extern char *		mapfile;
-extern int			rootflag;
-extern char *		user;
-extern int			version_code;
-extern char *		version_string;
-
-extern struct group *	groups;
-extern int				ngroups;
-extern int				mlgroups;
-extern double			delay;
-
-extern struct mode		sortmodes[];
-extern struct mode		infomodes[];
-extern struct mode		memmodes[];
-
 /* Various proc related data structures */
 
 #define PINFO_COMM_SIZE			32
@@ -259,6 +367,74 @@ struct process_info {
 	long int 		rss;		/* Resident Set Size	*/
 	unsigned long	wchan;
 	char 			strwchan[PINFO_WCHAN_SIZE];
+	int				filtered;	/* Rejected by the process filter */
+	int				cgroup;		/* Index in cgroup table, or -1 */
+	int				hnext;		/* Next process in pid hash chain */
+	unsigned long long	io_rbytes, io_wbytes;	/* From /proc/<pid>/io */
+	unsigned long long	io_syscr, io_syscw;
+	double			io_t;		/* Time of the last read of it */
+	int				io_serial;	/* I/O update it was last read in */
+	int				io_denied;	/* Not allowed to read it */
+	double			io_rrate, io_wrate;	/* Bytes per second */
+	double			io_rops, io_wops;	/* Syscalls per second */
+	unsigned long	pss, uss;	/* From /proc/<pid>/smaps_rollup, bytes */
+	double			pss_t;		/* Time of the last read of it */
+	int				pss_serial;	/* PSS update it was last read in */
+	int				pss_denied;	/* Not allowed to read it */
+	unsigned long long	sched_run;	/* CPU time in ns, from schedstat */
+	unsigned long long	sched_wait;	/* Run queue wait in ns, from schedstat */
+	double			sched_t;	/* Time of the last read of it */
+	int				sched_serial;	/* Update it was last read in */
+	int				sched_missing;	/* Kernel has no schedstat */
+	double			sched_rate;	/* Run queue wait in ms/s */
+	double			sched_cpu;	/* CPU time in s/s, over the same time */
+	int				top;		/* Was shown when equal to top_mark */
+	unsigned long long	blkio;	/* Block I/O delay in ticks, from stat */
+	double			blkio_rate;	/* in ms/s */
+	unsigned long	minflt, majflt;	/* Page faults, from stat */
+	double			minflt_rate, majflt_rate;	/* per second */
+	unsigned long	nvcsw, nivcsw;	/* Context switches, from status */
+	double			vcsw_rate, ivcsw_rate;	/* per second */
+	int				hist_cpu;	/* History series of CPU usage, or -1 */
+	int				hist_rss;	/* and of RSS */
+	struct cpu_window *	win;	/* CPU time over windows, or NULL */
+	int				session;	/* Session id */
+	int				agg_user;	/* User aggregate it is in, or -1 */
+	int				agg_session;	/* and session aggregate */
+	unsigned int	agg_groups;	/* Groups it is in, as a bit mask */
+	double			agg_cpu, agg_rss, agg_io;	/* What it added to them */
+	int				ppid;
+	int				parent;		/* Index of the parent in the tree, or -1 */
+	int				child;		/* First child, or -1 */
+	int				sibling;	/* Next child of the parent, or -1 */
+	int				tree_ppid;	/* ppid it was linked under, -1 if none */
+	double			sub_cpu, sub_rss;	/* Sums over the subtree */
+	int				sub_n;		/* # of processes in the subtree */
+	double			tree_cpu, tree_rss;	/* What it added to them */
+	int				tree_n;
+	int				shown;		/* Shown in the tree walk with this mark */
+	int				collapsed;	/* Children are not shown in the tree */
+	int				watched;	/* On the watch list, -1 if not checked,
+								 * or WATCH_WAITING */
+	int				watch_fd;	/* Open stat file, or -1 */
+	int				watch_sched_fd;	/* and schedstat file */
+	unsigned long	watch_jiffies;	/* utime + stime at the last sample */
+	unsigned long long	watch_run;	/* CPU time in ns at the last sample */
+	double			watch_t;	/* Time of the last sample */
+	double			watch_cpu;	/* CPU usage in %, over that sample */
+};
+
+/* CPU time of a process per WIN_BUCKET seconds, and its sum over the 1, 5
+ * and 15 minute windows */
+
+#define WIN_BUCKET			15
+#define WIN_SLOTS			(900 / WIN_BUCKET)
+#define WIN_NWINDOWS		3
+
+struct cpu_window {
+	long			bucket;		/* Latest bucket, in WIN_BUCKET seconds */
+	unsigned int	slot[WIN_SLOTS];	/* Jiffies per bucket */
+	unsigned long	sum[WIN_NWINDOWS];	/* Jiffies per window */
 };
 
 struct cpu_info {
@@ -275,6 +451,291 @@ struct cpu_info {
 	double			pct_nice;
 	double			nice[8];
 	unsigned long	nicejiffies;
+	int				runq_ok;	/* /proc/schedstat could be read */
+	double			runq_wait;	/* Run queue wait in ms/s, all CPUs */
+	double			runq_max;	/* and on the CPU with the most */
+};
+
+/* cgroup v2 statistics files, and the state of their cached fd */
+
+#define CG_CPU_STAT			0
+#define CG_MEMORY_CURRENT	1
+#define CG_MEMORY_STAT		2
+#define CG_IO_STAT			3
+#define CG_PIDS_CURRENT		4
+#define CG_NFILES			5
+
+#define CG_NOFILE			-1	/* File does not exist */
+#define CG_UNOPENED			-2	/* Not (yet) opened */
+
+struct fs_sample {
+	double			t;			/* Time of the sample */
+	double			bfree;		/* Bytes available */
+	double			ffree;		/* Free inodes */
+};
+
+/* The fields of /proc/diskstats after the device name, as far as we use
+ * them */
+
+#define DS_RD_IOS			0
+#define DS_RD_SECTORS		2
+#define DS_RD_TICKS			3
+#define DS_WR_IOS			4
+#define DS_WR_SECTORS		6
+#define DS_WR_TICKS			7
+#define DS_IO_TICKS			9
+#define DS_TIME_IN_QUEUE	10
+#define DISK_NFIELDS		11
+#define DISK_NAME_SIZE		32
+
+struct disk_info {
+	char			name[DISK_NAME_SIZE];
+	int				shown;		/* Passes the device filter */
+	int				serial;		/* Update it was last seen in */
+	double			t;			/* Time of the last sample */
+	unsigned long long	v[DISK_NFIELDS];	/* Counters at that time */
+	double			riops, wiops;	/* Reads and writes per second */
+	double			rbytes, wbytes;	/* Bytes per second */
+	double			util;		/* % of the time busy */
+	double			queue;		/* Average # of requests in flight */
+	double			await;		/* Average time per request in ms */
+};
+
+/* The fields of /proc/net/dev after the interface name, as far as we use
+ * them */
+
+#define ND_RX_BYTES			0
+#define ND_RX_PACKETS		1
+#define ND_RX_ERRS			2
+#define ND_RX_DROP			3
+#define ND_TX_BYTES			8
+#define ND_TX_PACKETS		9
+#define ND_TX_ERRS			10
+#define ND_TX_DROP			11
+#define NET_NFIELDS			12
+#define NET_NAME_SIZE		32
+
+struct net_info {
+	char			name[NET_NAME_SIZE];
+	int				shown;		/* Passes the interface filter */
+	int				serial;		/* Update it was last seen in */
+	double			t;			/* Time of the last sample */
+	unsigned long long	v[NET_NFIELDS];	/* Counters at that time */
+	double			rbytes, tbytes;	/* Bytes per second */
+	double			rpkts, tpkts;	/* Packets per second */
+	double			errs, drops;	/* Errors and drops per second */
+};
+
+/* The TCP counters from /proc/net/snmp and /proc/net/netstat */
+
+#define TCP_RETRANS			0
+#define TCP_OUT_SEGS		1
+#define TCP_OUT_RSTS		2
+#define TCP_ESTAB_RESETS	3
+#define TCP_LISTEN_OVF		4	/* From netstat */
+#define TCP_LISTEN_DROPS	5
+#define TCP_NFIELDS			6
+
+struct tcp_stats {
+	int				ok;			/* The counters could be read */
+	double			t;			/* Time of the last sample */
+	unsigned long long	v[TCP_NFIELDS];	/* Counters at that time */
+	double			rate[TCP_NFIELDS];	/* Per second */
+	double			pct_retrans;	/* % of the sent segments */
+};
+
+/* Socket counts from sock_diag. The TCP counts are indexed by the kernel's
+ * TCP states; request sockets have a state of their own. */
+
+#define SOCK_INTERVAL		10		/* Seconds between socket dumps */
+#define SOCK_BUFSIZE		65536	/* Netlink receive buffer */
+#define SOCK_TIMEOUT		1		/* Seconds a dump may stall */
+#define SOCK_NEW_SYN_RECV	12
+#define SOCK_NSTATES		13
+#define SOCK_ALL_STATES		0xffffffff
+#define SOCK_TCP_STATES		(SOCK_ALL_STATES & ~((1 << TCP_ESTABLISHED) | \
+							 (1 << TCP_TIME_WAIT)))
+
+struct sock_stats {
+	int				ok;			/* The last dump succeeded */
+	long			tcp[SOCK_NSTATES];	/* TCP sockets per state */
+	long			inuse, tw;	/* From /proc/net/sockstat */
+	long			udp;		/* UDP sockets, from sockstat */
+	long			unx;		/* Unix sockets, from protocols */
+};
+
+/* Pressure stall information of one resource */
+
+#define PSI_NRES			3
+#define PSI_THRESHOLD		200000	/* Trigger on 200 ms of stall ... */
+#define PSI_WINDOW			2000000	/* ... within 2 s */
+
+struct psi_info {
+	char *			name;		/* Resource, file in /proc/pressure */
+	int				fd;			/* Open for reading */
+	int				trig_fd;	/* Open with a trigger set */
+	int				wake;		/* Its wake index for xgetch() */
+	int				ok;			/* Could be read */
+	double			some, full;	/* 10 second averages, in % */
+};
+
+/* Paging and scheduler counters. The first VM_STAT_FIELDS come from
+ * /proc/vmstat, the others from /proc/stat. */
+
+#define VM_MAJFLT			0
+#define VM_PSWPIN			1
+#define VM_PSWPOUT			2
+#define VM_PGSCAN			3
+#define VM_PGSTEAL			4
+#define VM_OOM				5
+#define VM_STAT_FIELDS		6
+#define VM_CTXT				6
+#define VM_FORKS			7
+#define VM_NFIELDS			8
+
+struct vm_stats {
+	double			t;			/* Time of the last sample */
+	unsigned long long	v[VM_NFIELDS];		/* Counters now */
+	unsigned long long	old[VM_NFIELDS];	/* and at that time */
+	double			rate[VM_NFIELDS];	/* Per second */
+};
+
+/* A kernel log event */
+
+#define KMSG_HISTORY		64		/* # of events kept */
+#define KMSG_BUFSIZE		8192	/* More than the longest record */
+#define EVENT_SIZE			20
+
+struct event_info {
+	double			t;			/* Time it happened */
+	char			text[EVENT_SIZE+1];
+};
+
+/* History: the tiers, and the series. A series has a stream of compressed
+ * samples per tier, in blocks from a shared pool. */
+
+#define HIST_NTIERS			3
+#define HIST_BLOCK_SIZE		256		/* Bytes of samples per block */
+#define HIST_MAX_BITS		113		/* The most bits one sample takes */
+#define HIST_MEM			4096	/* Default pool size in K */
+#define HIST_NAME_SIZE		8
+#define HIST_WIDTH			14		/* Columns of a sparkline */
+
+#define HIST_SYS_CPU		0		/* The system series come first */
+#define HIST_SYS_LOAD		1
+#define HIST_SYS_MEM		2
+#define HIST_SYS_SWAP		3
+#define HIST_NSYS			4
+
+#define HIST_SYS			1		/* Kinds of series, 0 is free */
+#define HIST_CPU			2
+#define HIST_RSS			3
+
+struct hist_tier {
+	int				step;		/* Seconds between samples */
+	int				span;		/* Seconds kept */
+};
+
+struct hist_block {
+	int				next;		/* Next block in stream, or free list */
+	int				n;			/* # of samples */
+	int				nbits;		/* # of bits used */
+	int				lead, trail;	/* Window of the last XOR */
+	long			t0, t;		/* First and last time, in steps */
+	long			delta;		/* Last time difference */
+	unsigned long long	v0, v;	/* First and last value, as bits */
+	unsigned char	bits[HIST_BLOCK_SIZE];
+};
+
+struct hist_stream {
+	int				head, tail;	/* Oldest and newest block, or -1 */
+	long			t;			/* Step being averaged */
+	double			sum;		/* Sum of its samples */
+	int				n;			/* and their # */
+};
+
+struct hist_series {
+	char			name[HIST_NAME_SIZE];
+	int				kind;		/* HIST_SYS, HIST_CPU or HIST_RSS */
+	int				proc;		/* Process table entry */
+	int				pid;		/* Its pid, 0 if it is gone */
+	struct hist_stream	tiers[HIST_NTIERS];
+};
+
+struct listen_info {
+	int				port;		/* Local port */
+	int				nsocks;		/* # of sockets listening on it */
+	unsigned long	queue;		/* Connections waiting for accept() */
+	unsigned long	backlog;	/* Maximum of those */
+};
+
+/* A mounted filesystem. The probe fields are shared with the worker
+ * threads and protected by fs_lock. */
+
+struct mount_info {
+	char *			device;
+	char *			mntpoint;
+	char *			type;
+	int				remote;		/* Network filesystem */
+	int				serial;		/* Update it was last seen in */
+	int				pending;	/* Probe queued or running */
+	int				late;		/* Probe took longer than FS_DEADLINE */
+	int				hung;		/* and its worker was replaced */
+	int				gone;		/* Unmounted while a probe was pending */
+	double			interval;	/* Probe interval */
+	double			next;		/* Time of the next probe */
+	double			queued;		/* Time the probe was queued */
+	double			started;	/* Time the probe started, 0 if idle */
+	double			took;		/* Duration of the last probe */
+	double			probed;		/* Time of the last good probe */
+	int				valid;		/* There has been a good probe */
+	int				err;		/* errno of the last probe */
+	unsigned long	bsize, blocks, bfree, bavail;
+	unsigned long	files, ffree;
+	struct fs_sample samples[FS_WINDOW];	/* Ring of samples */
+	int				nsamples;	/* # of samples in the ring */
+	int				head;		/* Next sample to replace */
+	double			last;		/* Time of the last sample */
+	struct fs_sample base;		/* Origin of the sums */
+	double			sx, sxx, sy, sxy, sz, sxz;	/* Least-squares sums */
+	double			rate;		/* Bytes used per second */
+	double			irate;		/* Inodes used per second */
+	double			eta;		/* Seconds to full, 0 if not filling */
+	double			ieta;		/* Seconds to no inodes */
+};
+
+#define CG_HASH_SIZE		1021
+#define CG_NAME_SIZE		16
+
+struct cgroup_info {
+	char *			path;		/* Path below the cgroup root, NULL if free */
+	char			name[CG_NAME_SIZE];
+	int				hnext;		/* Next cgroup in hash chain */
+	int				fds[CG_NFILES];
+	int				serial;		/* Update the statistics were read */
+	unsigned long long	usage;	/* cpu.stat usage_usec */
+	double			pct_cpu;
+	unsigned long	memory;		/* memory.current */
+	unsigned long	anon, file;	/* from memory.stat */
+	unsigned long long	rbytes, wbytes;	/* Sum of io.stat over devices */
+	double			rrate, wrate;	/* I/O in bytes/s */
+	int				pids;		/* pids.current */
+	int				nprocs;		/* Rolled up from the process table */
+	double			proc_cpu;
+	unsigned long	proc_rss;
+};
+
+struct stage_info {
+	char *			name;
+	char *			label;		/* Name in the profile overlay */
+	double			start;		/* Start of the current run */
+	double			tick;		/* Time in this update so far */
+	int				ran;		/* Ran in this update */
+	double			last;		/* Time in the last update */
+	unsigned long	n;			/* # of updates */
+	double			total;
+	unsigned long	max;		/* in usecs */
+	unsigned int	lat[LAT_BUCKETS];
 };
 
 #define MSG_TEXT_SIZE		64
@@ -312,9 +773,379 @@ struct group {
 	struct grp_member * members;
 };
 
+/* The sources of data, see source.c. A source with a period of its own
+ * waits for the next update once SOURCE_SPREAD seconds were spent on such
+ * sources, and its cost is averaged with weight SOURCE_WEIGHT. */
+
+#define NSOURCES			16
+#define SOURCE_SPREAD		0.002
+#define SOURCE_WEIGHT		0.25
+
+struct source_info {
+	char *			name;		/* Name in the config file */
+	int				stage;		/* Profile stage it is timed in */
+	int				(*update)( void);
+	double			period;		/* Seconds between reads, 0 = every update */
+	double			cost;		/* Seconds per read */
+	double			next;		/* Time it is due */
+	double			last;		/* Time it was last read, or 0 */
+};
+
+/* The watch list */
+
+#define WATCH_MAX			8		/* Processes on it */
+#define WATCH_PERIOD		0.1		/* Seconds between samples */
+#define WATCH_WAITING		-2		/* Matches, but the list was full */
+
+/* The threads of the selected process */
+
+#define THREAD_PERIOD		0.5		/* Seconds between samples */
+
+struct thread_info {
+	int				tid;
+	int				serial;		/* Sample it was last seen in */
+	int				fd;			/* Open stat file, or -1 */
+	int				wchan_fd;	/* and wchan file */
+	int				sched_fd;	/* and schedstat file */
+	char			comm[PINFO_COMM_SIZE];
+	char			state;
+	int				cpu;		/* CPU it last ran on */
+	unsigned long	jiffies;	/* CPU time used */
+	unsigned long long	run;	/* in ns, from schedstat, or 0 */
+	double			pct_cpu;	/* over the last sample */
+	char			wchan[PINFO_WCHAN_SIZE];
+};
+
+/* Processes summed per user, per group and per session */
+
+#define AGGR_USER			0
+#define AGGR_GROUP			1
+#define AGGR_SESSION		2
+#define AGGR_NKINDS			3
+
+#define AGGR_NAME_SIZE		16
+#define AGGR_HASH_SIZE		64		/* Must be a power of 2 */
+#define AGGR_MAX_GROUPS		32		/* Bits in agg_groups */
+
+struct aggr_info {
+	int				key;		/* uid, group index or session id */
+	char			name[AGGR_NAME_SIZE];
+	int				hnext;		/* Next aggregate in hash chain */
+	int				nprocs;		/* # of processes, 0 if free */
+	double			cpu;		/* Sums over the processes */
+	double			rss;
+	double			io;			/* Bytes read and written per second */
+};
+
+struct aggr_table {
+	struct aggr_info *	a;
+	int				maxi;		/* Max index in use */
+	int				size;
+	int				hash[AGGR_HASH_SIZE];
+};
+
 struct mode {
 	char l[32];
 	char s[8];
 };
 
+/* Definitions from proc.c */
+
+extern struct cpu_info			cpu;		/* CPU state info		*/
+extern struct mem_info			mem;		/* Memory info			*/
+extern struct utmp *			logins;		/* utmp array			*/
+extern struct process_info *	procs;		/* process table		*/
+extern double 					loads[];	/* load averages		*/
+
+extern int nlogins;			/* # of entries in utmp 				*/
+
+extern int procs_maxi;		/* Max index in process table			*/
+extern double jiffies;		/* # of ticks since the source last ran	*/
+extern double update_t;		/* Time of this update					*/
+extern long clk_tck;		/* # of ticks per second				*/
+
+int 		proc_init			(void);
+int			read_procs			(void);
+int			read_procio			(void);
+int			read_procpss		(void);
+int			read_procsched		(void);
+int			read_schedstat		(void);
+int			read_loads			(void);
+int 		read_cpu			(void);
+int			read_mem			(void);
+int			read_logins			(void);
+void 		proc_update			(int);
+void		proc_close			(void);
+int			proc_lookup			(int);
+
+/* Definitions from cgroup.c: */
+
+extern struct cgroup_info *		cgroups;	/* cgroup table			*/
+
+extern int cgroups_maxi;	/* Max index in cgroup table			*/
+extern int cgroup_ok;		/* Nonzero if cgroup v2 is mounted		*/
+
+int			cgroup_init			(void);
+void		cgroup_member		(struct process_info *);
+int			cgroup_update		(void);
+int			cgroup_sort			(int *, int);
+
+/* Definitions from fs.c: */
+
+extern struct mount_info **		mounts;		/* mount table			*/
+extern int nmounts;			/* # of entries in mount table			*/
+extern pthread_mutex_t fs_lock;	/* Protects the mount table			*/
+extern char *	fsinclude;	/* Filesystem types to check			*/
+extern char *	fsexclude;	/* and not to check						*/
+
+int			fs_init				(void);
+int			check_diskfree		(void);
+int			fs_sort				(struct mount_info **, int);
+double		fs_used				(struct mount_info *);
+
+/* Definitions from disk.c: */
+
+extern struct disk_info *		disks;		/* block devices		*/
+extern int ndisks;			/* # of entries in disk table			*/
+extern char *	diskinclude;	/* Devices to show					*/
+extern char *	diskexclude;	/* and not to show					*/
+
+int			disk_init			(void);
+int			read_disks			(void);
+int			disk_sort			(int *, int);
+
+/* Definitions from net.c: */
+
+extern struct net_info *		nets;		/* network interfaces	*/
+extern struct tcp_stats			tcpstats;	/* TCP counters			*/
+extern int nnets;			/* # of entries in net table			*/
+extern char *	netinclude;		/* Interfaces to show				*/
+extern char *	netexclude;		/* and not to show					*/
+
+int			net_init			(void);
+int			read_net			(void);
+int			net_sort			(int *, int);
+
+/* Definitions from sock.c: */
+
+extern struct sock_stats		sockstats;	/* socket counts		*/
+extern struct listen_info *		listens;	/* listen queues		*/
+extern int nlistens;		/* # of entries in listen table			*/
+
+int			sock_init			(void);
+int			read_sockets		(void);
+void		listen_sort			(void);
+
+/* Definitions from psi.c: */
+
+extern struct psi_info			psi[];		/* pressure per resource */
+extern struct vm_stats			vmstats;	/* paging counters		*/
+
+int			psi_init			(void);
+int			read_psi			(void);
+int			psi_wake			(void);
+
+/* Definitions from kmsg.c: */
+
+extern struct event_info		events[];	/* kernel events ring	*/
+extern int nevents;			/* # of events in it					*/
+extern int events_next;		/* Its next slot						*/
+extern int events_top;		/* First event shown					*/
+
+int			kmsg_init			(void);
+int			kmsg_check			(void);
+void		kmsg_scroll			(int);
+
+/* Definitions from window.c: */
+
+extern struct process_info *	ghosts;		/* exited processes		*/
+extern int nghosts;			/* # of entries in ghost table			*/
+
+int			window_init			(void);
+void		window_add			(struct process_info *, unsigned long);
+double		window_pct			(struct process_info *, int);
+void		window_exit			(struct process_info *);
+void		window_update		(void);
+
+/* Definitions from aggr.c: */
+
+extern struct aggr_table		aggrs[];	/* aggregates per kind	*/
+
+int			aggr_init			(void);
+void		aggr_update			(struct process_info *);
+void		aggr_remove			(struct process_info *);
+int			aggr_sort			(int, struct aggr_info **, int);
+
+/* Definitions from tree.c: */
+
+void		tree_update			(int);
+void		tree_remove			(int);
+int			tree_sort			(int *, int *, int);
+int			tree_collapse		(int);
+
+/* Definitions from thread.c: */
+
+extern struct thread_info *		threads;	/* threads shown		*/
+extern int nthreads;		/* # of entries in thread table			*/
+extern int thread_pid;		/* Process they belong to, or 0			*/
+extern int thread_timer;	/* timerfd for the samples, or -1		*/
+extern char thread_comm[];	/* Command of that process				*/
+
+int			thread_init			(void);
+int			thread_select		(int);
+int			thread_sample		(void);
+int			thread_wake			(void);
+int			thread_sort			(int *, int);
+
+/* Definitions from watch.c: */
+
+extern int watched[];		/* Watched processes, as indices		*/
+extern int nwatched;		/* # of them							*/
+extern char * watch_names;	/* Patterns of processes to watch		*/
+extern double watch_period;	/* Seconds between samples				*/
+
+int			watch_init			(void);
+void		watch_check			(int);
+void		watch_stop			(int);
+int			watch_toggle		(int);
+int			watch_wake			(void);
+
+/* Definitions from source.c: */
+
+extern struct source_info		sources[];	/* data sources			*/
+
+void		source_update		(void);
+int			source_set			(const char *, double);
+void		source_due			(const char *);
+double		source_age			(int);
+
+/* Definitions from history.c: */
+
+extern struct hist_series *		series;		/* history series		*/
+extern struct hist_tier			hist_tiers[];	/* their tiers		*/
+extern int series_maxi;		/* Max index in series table			*/
+extern int hist_mem;		/* Size of the history pool in K		*/
+
+int			hist_init			(void);
+int			hist_update			(void);
+void		hist_watch			(int, double);
+double		hist_fetch			(int, int, double *, int);
+
+/* Definitions from screen.c: */
+
+extern int nprocs;			/* # of processes shown					*/
+extern int pids[];			/* Pids of the processes shown			*/
+extern int top_mark;		/* Marks the processes shown			*/
+
+
+int			screen_init			(int);
+void		screen_setup		(void);
+void 		screen_update		(void);
+void		screen_close		(void);
+void		show_help			(void);
+
+void		let_user_kill		(int);
+void		let_user_write		(void);
+void		let_user_renice		(void);
+void		let_user_collapse	(void);
+void		let_user_threads	(void);
+void		let_user_watch		(void);
+
+char *		get_string			(const char *, char);
+void		queue_msg			(int, const char *, ...);
+void		notice				(const char *, ...);
+void		xsleep				(int);
+int			xgetch				(int,int);
+int			wake_add			(int, short);
+int			wake_ready			(int);
+
+extern int nmessages;		/* # of messages in message queue		*/
+
+extern struct msg_entry *		messages;	/* message queue		*/
+
+/* Definitions from util.c: */
+
+void *		xmalloc( size_t);
+void *		xrealloc( void *, size_t);
+char *		strnzcpy( char *, const char *, size_t);
+double		mono_time( void);
+int			match_list( const char *, const char *);
+int			readfile( const char *, int *, char **, int *);
+
+/* Definitions from prof.c: */
+
+extern struct stage_info		stages[];	/* stage timings		*/
+extern double	self_cpu;			/* our CPU usage in %	*/
+extern long		self_rwcalls;		/* our r/w calls per update */
+
+void		prof_begin			(int);
+void		prof_end			(int);
+double		prof_lap			(int, double);
+void		prof_tick			(int);
+void		prof_reset			(void);
+unsigned long	prof_percentile	(int, double);
+double		self_time			(void);
+long		read_rwcalls		(void);
+
+/* Definitions from filter.c: */
+
+int			filter_set			(const char *);
+int			filter_match		(struct process_info *, int);
+
+extern char *		filter_expr;	/* current filter expression	*/
+extern char			filter_errmsg[];
+
+/* Definitions from hifs.c: */
+
+extern int			memory;
+extern int			info;
+extern int			sort;
+extern int			page;
+extern int			cgsort;
+extern int			fssort;
+extern int			disksort;
+extern int			netsort;
+extern int			socksort;
+extern int			histmode;
+extern int			aggrsort;
+extern int			treesort;
+extern int			threadsort;
+extern int			min_diskfree;
+extern int			majflt_warn;
+
+extern int			warned;
+extern char *		mapfile;
+extern char *		procroot;
+extern char *		utmpfile;
+extern int			bench;
+extern int			profile;
+extern int			rootflag;
+extern char *		user;
+extern int			version_code;
+extern char *		version_string;
+
+extern struct group *	groups;
+extern int				ngroups;
+extern int				mlgroups;
+extern double			delay;
+extern double			period;
+extern double			budget;
+
+extern struct mode		sortmodes[];
+extern struct mode		infomodes[];
+extern struct mode		memmodes[];
+extern struct mode		pagemodes[];
+extern struct mode		cgsortmodes[];
+extern struct mode		fssortmodes[];
+extern struct mode		disksortmodes[];
+extern struct mode		netsortmodes[];
+extern struct mode		socksortmodes[];
+extern struct mode		histmodes[];
+extern struct mode		aggrsortmodes[];
+extern struct mode		treesortmodes[];
+extern struct mode		threadsortmodes[];
+
+void		set_update			(double);
+void		adapt_period		(void);
+
 #endif 	/* ! _HIFS_H */
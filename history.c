@@ -0,0 +1,471 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * history.c: History of the system metrics, and of the CPU usage and RSS
+ * of every process that was shown, in three tiers: 1 second samples for
+ * 10 minutes, 10 second samples for 6 hours and 1 minute samples for 7
+ * days. The samples are compressed like in Facebook's Gorilla: the
+ * timestamps as delta of deltas, the values as the XOR with the previous
+ * one. They are kept in blocks of a fixed size, taken from a pool of at
+ * most `hist_mem' kilobytes. When the pool is full, the block with the
+ * oldest samples is reused.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct hist_series *	series		= NULL;	/* all series				*/
+struct hist_block *		hblocks		= NULL;	/* block pool				*/
+
+int					series_maxi		= 0;	/* Max index in series table */
+int					series_size		= 16;	/* initial series table size */
+int					hblocks_n		= 0;	/* # of blocks allocated	*/
+int					hblocks_size	= 0;	/* size of block pool		*/
+int					hblocks_free	= -1;	/* free list of blocks		*/
+int					hist_mem		= HIST_MEM;	/* pool size in K		*/
+
+/* The step and the span of each tier, in seconds */
+
+struct hist_tier hist_tiers[HIST_NTIERS] = {
+	{ 1, 600 },
+	{ 10, 6 * 3600 },
+	{ 60, 7 * 86400 }
+};
+
+char *	hist_sysnames[HIST_NSYS] = { "cpu", "load", "mem", "swap" };
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			hist_new			(const char *, int, int);
+int			hist_alloc			(void);
+void		hist_release		(struct hist_stream *);
+void		hist_put			(struct hist_block *, unsigned long long,
+									 int);
+unsigned long long	hist_get	(struct hist_block *, int *, int);
+void		hist_append			(struct hist_stream *, long, double);
+void		hist_add			(int, double, double);
+void		hist_flush			(int);
+void		hist_expire			(int, double);
+
+/* ------------------------------------------------------------------------
+ * hist_new: Create a series named `name' of `kind', for process table
+ * entry `proc' if it is about a process. Returns its index. */
+
+int hist_new( const char * name, int kind, int proc)
+{
+	struct hist_series * s;
+	int i, k;
+
+	for (i=0; (i < series_maxi) && series[i].kind; i++);
+	if (i == series_maxi) {
+		if (i == series_size)
+			series = xrealloc( series, (series_size *= 2) *
+					sizeof (struct hist_series));
+		series_maxi++;
+	}
+	s = series + i;
+	memset( s, 0, sizeof (struct hist_series));
+	strnzcpy( s->name, name, HIST_NAME_SIZE);
+	s->kind = kind;
+	s->proc = proc;
+	s->pid = (proc == -1) ? 0 : procs[proc].pid;
+	for (k=0; k<HIST_NTIERS; k++)
+		s->tiers[k].head = s->tiers[k].tail = -1;
+	return (i);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_release: Put the oldest block of stream `st' on the free list. */
+
+void hist_release( struct hist_stream * st)
+{
+	int b;
+
+	b = st->head;
+	if (st->tail == b)
+		st->head = st->tail = -1;
+	else
+		st->head = hblocks[b].next;
+	hblocks[b].next = hblocks_free;
+	hblocks_free = b;
+}
+
+/* ------------------------------------------------------------------------
+ * hist_alloc: Return a free block. If the pool is at its size, the block
+ * whose last sample is the oldest is taken from its stream. Returns -1
+ * if the pool cannot hold a single block. */
+
+int hist_alloc( void)
+{
+	struct hist_stream * st, * oldest;
+	double t, tmin;
+	int b, i, k, max;
+
+	max = (long) hist_mem * 1024 / sizeof (struct hist_block);
+	if ((hblocks_free == -1) && (hblocks_n < max)) {
+		if (hblocks_n == hblocks_size) {
+			hblocks_size = hblocks_size ? hblocks_size * 2 : 64;
+			if (hblocks_size > max)
+				hblocks_size = max;
+			hblocks = xrealloc( hblocks, hblocks_size *
+					sizeof (struct hist_block));
+		}
+		hblocks[hblocks_n].next = hblocks_free;
+		hblocks_free = hblocks_n++;
+	}
+
+	if (hblocks_free == -1) {
+		oldest = NULL;
+		tmin = 0;
+		for (i=0; i<series_maxi; i++)
+			for (k=0; series[i].kind && (k<HIST_NTIERS); k++) {
+				st = series[i].tiers + k;
+				if (st->head == -1)
+					continue;
+				t = (double) hblocks[st->head].t * hist_tiers[k].step;
+				if (!oldest || (t < tmin)) {
+					oldest = st;
+					tmin = t;
+				}
+			}
+		if (!oldest)
+			return (-1);
+		hist_release( oldest);
+	}
+	b = hblocks_free;
+	hblocks_free = hblocks[b].next;
+	return (b);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_put: Append the `n' low bits of `v' to block `b', high bit first. */
+
+void hist_put( struct hist_block * b, unsigned long long v, int n)
+{
+	while (n--) {
+		if ((v >> n) & 1)
+			b->bits[b->nbits >> 3] |= 0x80 >> (b->nbits & 7);
+		else
+			b->bits[b->nbits >> 3] &= ~(0x80 >> (b->nbits & 7));
+		b->nbits++;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * hist_get: Read `n' bits from block `b' at bit `*pos', and advance it. */
+
+unsigned long long hist_get( struct hist_block * b, int * pos, int n)
+{
+	unsigned long long v = 0;
+
+	while (n--) {
+		v = (v << 1) | ((b->bits[*pos >> 3] >> (7 - (*pos & 7))) & 1);
+		(*pos)++;
+	}
+	return (v);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_append: Append the sample `v' at time `t', in steps of the tier,
+ * to stream `st'. The first sample of a block is kept in its header. */
+
+void hist_append( struct hist_stream * st, long t, double v)
+{
+	struct hist_block * b;
+	unsigned long long bits, x;
+	long dod;
+	int i, lead, trail;
+
+	memcpy( &bits, &v, sizeof (bits));
+	if ((st->tail == -1) ||
+			(hblocks[st->tail].nbits + HIST_MAX_BITS > HIST_BLOCK_SIZE * 8)) {
+		if ((i = hist_alloc()) == -1)
+			return;
+		b = hblocks + i;
+		b->next = -1;
+		b->t0 = b->t = t;
+		b->delta = 1;
+		b->v0 = b->v = bits;
+		b->lead = 64;
+		b->trail = 0;
+		b->nbits = 0;
+		b->n = 1;
+		if (st->tail == -1)
+			st->head = i;
+		else
+			hblocks[st->tail].next = i;
+		st->tail = i;
+		return;
+	}
+	b = hblocks + st->tail;
+
+	/* The timestamp: the change in the time between samples */
+
+	dod = (t - b->t) - b->delta;
+	if (!dod)
+		hist_put( b, 0, 1);
+	else if ((dod >= -64) && (dod < 64)) {
+		hist_put( b, 2, 2);
+		hist_put( b, dod, 7);
+	} else if ((dod >= -256) && (dod < 256)) {
+		hist_put( b, 6, 3);
+		hist_put( b, dod, 9);
+	} else if ((dod >= -2048) && (dod < 2048)) {
+		hist_put( b, 14, 4);
+		hist_put( b, dod, 12);
+	} else {
+		hist_put( b, 15, 4);
+		hist_put( b, dod, 32);
+	}
+	b->delta = t - b->t;
+	b->t = t;
+
+	/* The value: the bits that changed. If they fall within those that
+	 * changed last time, only they are stored. */
+
+	x = bits ^ b->v;
+	b->v = bits;
+	b->n++;
+	if (!x) {
+		hist_put( b, 0, 1);
+		return;
+	}
+	for (lead=0; (lead < 31) && !(x & (1ULL << (63 - lead))); lead++);
+	for (trail=0; !(x & (1ULL << trail)); trail++);
+	if ((lead >= b->lead) && (trail >= b->trail)) {
+		hist_put( b, 2, 2);
+		hist_put( b, x >> b->trail, 64 - b->lead - b->trail);
+	} else {
+		hist_put( b, 3, 2);
+		hist_put( b, lead, 5);
+		hist_put( b, 64 - lead - trail - 1, 6);
+		hist_put( b, x >> trail, 64 - lead - trail);
+		b->lead = lead;
+		b->trail = trail;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * hist_add: Add sample `v' at time `now' to series `s'. Every tier
+ * averages the samples within one step, and appends the average when the
+ * step is over. */
+
+void hist_add( int s, double now, double v)
+{
+	struct hist_stream * st;
+	long t;
+	int k;
+
+	for (k=0; k<HIST_NTIERS; k++) {
+		st = series[s].tiers + k;
+		t = now / hist_tiers[k].step;
+		if (st->n && (t != st->t)) {
+			hist_append( st, st->t, st->sum / st->n);
+			st->sum = st->n = 0;
+		}
+		st->t = t;
+		st->sum += v;
+		st->n++;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * hist_expire: Release the blocks of series `s' whose last sample is older
+ * than the span of their tier. */
+
+void hist_expire( int s, double now)
+{
+	struct hist_stream * st;
+	int k;
+
+	for (k=0; k<HIST_NTIERS; k++) {
+		st = series[s].tiers + k;
+		while ((st->head != -1) && ((long) (now / hist_tiers[k].step) - 
+				hblocks[st->head].t) * hist_tiers[k].step > 
+				hist_tiers[k].span)
+			hist_release( st);
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * hist_flush: Append the steps that are not over of series `s', which has
+ * no more samples. */
+
+void hist_flush( int s)
+{
+	struct hist_stream * st;
+	int k;
+
+	for (k=0; k<HIST_NTIERS; k++) {
+		st = series[s].tiers + k;
+		if (st->n)
+			hist_append( st, st->t, st->sum / st->n);
+		st->sum = st->n = 0;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * hist_watch: Add a sample of the watched process `i', taken at time `now'.
+ * These come more often than the updates, and hist_update() leaves the
+ * series of a watched process alone once it was sampled. */
+
+void hist_watch( int i, double now)
+{
+	struct process_info * p = procs + i;
+
+	if (p->hist_cpu == -1) {
+		p->hist_cpu = hist_new( p->comm, HIST_CPU, i);
+		p->hist_rss = hist_new( p->comm, HIST_RSS, i);
+	}
+	hist_add( p->hist_cpu, now, p->watch_cpu);
+	hist_add( p->hist_rss, now, p->rss);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_update: Add the current values to the history. Processes that are
+ * shown get a CPU and an RSS series. Called after every data update. */
+
+int hist_update( void)
+{
+	struct hist_series * s;
+	struct process_info * p;
+	double now, v;
+	int i, j, k;
+
+	now = mono_time();
+
+	i = cpu.index;
+	hist_add( HIST_SYS_CPU, now, (cpu.user[i] + cpu.nice[i] +
+			cpu.system[i]) * 100);
+	hist_add( HIST_SYS_LOAD, now, loads[0]);
+	hist_add( HIST_SYS_MEM, now, mem.used);
+	hist_add( HIST_SYS_SWAP, now, mem.swapused);
+
+	for (i=0; i<nprocs; i++) {
+		if (((j = proc_lookup( pids[i])) == -1) || (procs[j].hist_cpu != -1))
+			continue;
+		procs[j].hist_cpu = hist_new( procs[j].comm, HIST_CPU, j);
+		procs[j].hist_rss = hist_new( procs[j].comm, HIST_RSS, j);
+	}
+
+	/* The series of a process that is gone is kept until its last block
+	 * expires */
+
+	for (i=0; i<series_maxi; i++) {
+		s = series + i;
+		if (!s->kind)
+			continue;
+		if (s->pid) {
+			p = procs + s->proc;
+			if ((p->pid == s->pid) && (i == ((s->kind == HIST_CPU) ?
+					p->hist_cpu : p->hist_rss))) {
+				v = (s->kind == HIST_CPU) ? p->times[p->index] * 100 : p->rss;
+				if ((p->watched <= 0) || !p->watch_t)
+					hist_add( i, now, v);
+			} else {
+				hist_flush( i);
+				s->pid = 0;
+			}
+		}
+		hist_expire( i, now);
+		if ((s->kind == HIST_SYS) || s->pid)
+			continue;
+		for (k=0; (k < HIST_NTIERS) && (s->tiers[k].head == -1); k++);
+		if (k == HIST_NTIERS)
+			s->kind = 0;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_fetch: Put the maximum of series `s' in tier `tier' over `ncols'
+ * equal parts of the span in `cols', the last part ending now. A part
+ * without samples is -1. Returns the maximum of all. */
+
+double hist_fetch( int s, int tier, double * cols, int ncols)
+{
+	struct hist_stream * st;
+	struct hist_block * b;
+	unsigned long long bits, x;
+	long t, from, delta, dod, width;
+	int i, c, pos, lead, trail, len;
+	double v, max;
+
+	st = series[s].tiers + tier;
+	width = (hist_tiers[tier].span / hist_tiers[tier].step + ncols - 1) /
+			ncols;
+	from = (long) (mono_time() / hist_tiers[tier].step) + 1 - width * ncols;
+	for (c=0; c<ncols; c++)
+		cols[c] = -1;
+	max = 0;
+
+	for (i=st->head; i != -1; i=b->next) {
+		b = hblocks + i;
+		t = b->t0;
+		bits = b->v0;
+		delta = 1;
+		lead = 64;
+		trail = 0;
+		for (c=pos=0; c < b->n; c++) {
+			if (c) {
+				if (!hist_get( b, &pos, 1))
+					dod = 0;
+				else if (!hist_get( b, &pos, 1))
+					dod = (long) (hist_get( b, &pos, 7) << 57) >> 57;
+				else if (!hist_get( b, &pos, 1))
+					dod = (long) (hist_get( b, &pos, 9) << 55) >> 55;
+				else if (!hist_get( b, &pos, 1))
+					dod = (long) (hist_get( b, &pos, 12) << 52) >> 52;
+				else
+					dod = (long) (hist_get( b, &pos, 32) << 32) >> 32;
+				delta += dod;
+				t += delta;
+				if (hist_get( b, &pos, 1)) {
+					if (hist_get( b, &pos, 1)) {
+						lead = hist_get( b, &pos, 5);
+						len = hist_get( b, &pos, 6) + 1;
+						trail = 64 - lead - len;
+					}
+					x = hist_get( b, &pos, 64 - lead - trail);
+					bits ^= x << trail;
+				}
+			}
+			memcpy( &v, &bits, sizeof (v));
+			if ((t >= from) && ((t - from) / width < ncols)) {
+				if (v > cols[(t - from) / width])
+					cols[(t - from) / width] = v;
+				if (v > max)
+					max = v;
+			}
+		}
+	}
+
+	/* The step that is not over yet */
+
+	if (st->n && (st->t >= from)) {
+		v = st->sum / st->n;
+		if (v > cols[ncols-1])
+			cols[ncols-1] = v;
+		if (v > max)
+			max = v;
+	}
+	return (max);
+}
+
+/* ------------------------------------------------------------------------
+ * hist_init: Allocate the series table and create the system series. */
+
+int hist_init( void)
+{
+	int i;
+
+	series = xmalloc( series_size * sizeof (struct hist_series));
+	for (i=0; i<HIST_NSYS; i++)
+		hist_new( hist_sysnames[i], HIST_SYS, -1);
+	return (0);
+}
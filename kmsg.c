@@ -0,0 +1,183 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * kmsg.c: Kernel log events. /dev/kmsg is read without blocking whenever
+ * the main loop sees that it has records. Each read returns one record,
+ * which is parsed in a fixed buffer. OOM kills, hung tasks, segfaults and
+ * disk errors become messages, and are kept in a small ring for the
+ * events page.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int					kmsg_fd			= -1;	/* open /dev/kmsg			*/
+int					kmsg_wake		= -1;	/* its wake index			*/
+int					nevents			= 0;	/* # of events in the ring	*/
+int					events_next		= 0;	/* next slot in the ring	*/
+int					events_top		= 0;	/* first event shown		*/
+
+struct event_info	events[KMSG_HISTORY];	/* the last kernel events	*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			kmsg_parse			(char *, char *);
+void		kmsg_event			(double, const char *, int);
+int			read_kmsg			(int);
+
+/* ------------------------------------------------------------------------
+ * kmsg_parse: Recognise an event in kernel message `s'. If it is one,
+ * describe it in at most EVENT_SIZE characters in `out' and return
+ * nonzero. */
+
+int kmsg_parse( char * s, char * out)
+{
+	char comm[32], dev[32], line[64], * p;
+	int pid, secs;
+	unsigned long rss;
+
+	/* Out of memory: Killed process 4711 (java) total-vm:8056644kB,
+	 * anon-rss:4007712kB, ... The memory cgroup version says the same.
+	 * The fields can be longer than an event, so the line is made in
+	 * `line', which fits them all, and cut to size. */
+
+	if ((p = strstr( s, "Killed process ")) &&
+			(sscanf( p, "Killed process %d (%31[^)])", &pid, comm) == 2)) {
+		rss = (p = strstr( p, "anon-rss:")) ? atol( p+9) : 0;
+		sprintf( line, "OOM %.8s(%d) %luM", comm, pid, rss >> 10);
+		strnzcpy( out, line, EVENT_SIZE+1);
+		return (1);
+	}
+
+	/* INFO: task nginx:4711 blocked for more than 120 seconds. */
+
+	if ((p = strstr( s, "INFO: task ")) &&
+			(sscanf( p, "INFO: task %31[^:]:%d blocked for more than %d",
+			comm, &pid, &secs) == 3)) {
+		snprintf( out, EVENT_SIZE+1, "hung %.8s(%d) %ds", comm, pid, secs);
+		return (1);
+	}
+
+	/* nginx[4711]: segfault at 0 ip ... */
+
+	if ((p = strstr( s, "]: segfault at ")) &&
+			(sscanf( s, "%31[^[][%d]", comm, &pid) == 2)) {
+		snprintf( out, EVENT_SIZE+1, "segv %.8s(%d)", comm, pid);
+		return (1);
+	}
+
+	/* I/O error, dev sda, sector 4711 ... and EXT4-fs error (device sda1) */
+
+	if (((p = strstr( s, "I/O error, dev ")) &&
+			(sscanf( p, "I/O error, dev %31[^, ]", dev) == 1)) ||
+			((p = strstr( s, "error (device ")) &&
+			(sscanf( p, "error (device %31[^)])", dev) == 1))) {
+		snprintf( out, EVENT_SIZE+1, "I/O error %.10s", dev);
+		return (1);
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * kmsg_event: Put event `text' that happened at time `t' in the ring, and
+ * tell the user unless `quiet'. */
+
+void kmsg_event( double t, const char * text, int quiet)
+{
+	struct event_info * e;
+
+	e = events + events_next;
+	events_next = (events_next + 1) % KMSG_HISTORY;
+	if (nevents < KMSG_HISTORY)
+		nevents++;
+	e->t = t;
+	strcpy( e->text, text);
+	if (!quiet)
+		queue_msg( MAX_PRIO, "%s", text);
+}
+
+/* ------------------------------------------------------------------------
+ * read_kmsg: Read the records that are waiting in /dev/kmsg. A record is
+ * "prio,seq,usecs,flags;message", with continuation lines after it that we
+ * ignore. The time is in microseconds of the monotonic clock. If `quiet',
+ * the events are only put in the ring. */
+
+int read_kmsg( int quiet)
+{
+	char buf[KMSG_BUFSIZE], text[EVENT_SIZE+1], * p;
+	unsigned long long usecs;
+	double boot;
+	int n;
+
+	boot = time( NULL) - mono_time();
+	for (;;) {
+		if ((n = read( kmsg_fd, buf, KMSG_BUFSIZE-1)) == -1) {
+			if (errno == EPIPE)
+				continue;			/* Overwritten before we read it */
+			break;
+		}
+		if (!n)
+			break;
+		buf[n] = '\000';
+		if ((p = strchr( buf, '\n')))
+			*p = '\000';
+		if (!(p = strchr( buf, ';')) ||
+				(sscanf( buf, "%*u,%*u,%llu", &usecs) != 1))
+			continue;
+		if (kmsg_parse( p+1, text))
+			kmsg_event( boot + usecs / 1e6, text, quiet);
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * kmsg_check: Called when xgetch() was woken by a wake descriptor. Reads
+ * the kernel log if it has records. The events are reported through the
+ * message queue, which the SIGALRM handler uses too, so that signal is
+ * blocked meanwhile. */
+
+int kmsg_check( void)
+{
+	sigset_t set, oset;
+
+	if ((kmsg_wake == -1) || !wake_ready( kmsg_wake))
+		return (0);
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	read_kmsg( 0);
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * kmsg_scroll: Scroll the events page by `n' lines, down if positive. */
+
+void kmsg_scroll( int n)
+{
+	events_top += n;
+	if (events_top > nevents - MAX_SHOWPROCESSES)
+		events_top = nevents - MAX_SHOWPROCESSES;
+	if (events_top < 0)
+		events_top = 0;
+}
+
+/* ------------------------------------------------------------------------
+ * kmsg_init: Open /dev/kmsg, put the events that are already in the log
+ * in the ring, and register it with xgetch(). Reading the kernel log may
+ * not be allowed (dmesg_restrict); there are no events then. */
+
+int kmsg_init( void)
+{
+	memset( events, 0, sizeof (events));
+	if ((kmsg_fd = open( "/dev/kmsg", O_RDONLY | O_NONBLOCK)) == -1)
+		return (0);
+	read_kmsg( 1);
+	kmsg_wake = wake_add( kmsg_fd, POLLIN);
+	return (0);
+}
@@ -0,0 +1,566 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * mkfixture.c: Build a synthetic proc filesystem to benchmark hifs with.
+ *
+ *   mkfixture [-n NPROCS] [-s SEED] DIR	Create a new fixture in DIR
+ *   mkfixture -m DIR						Advance the fixture by one tick
+ *
+ * DIR/proc is used as the proc root, DIR/utmp as the utmp file. The mount
+ * points listed in DIR/proc/mounts live in DIR/mnt. Every tick is one
+ * second of 100 jiffies. About one process in ten is busy and gets its
+ * stat file rewritten every tick, and one in a hundred exits and is
+ * replaced by a new process.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <dirent.h>
+#include <utmp.h>
+
+#define HZ				100
+#define NCPUS			4
+#define MEMTOTAL		(16UL * 1024 * 1024)	/* in Kb */
+#define PAGESIZE		4096
+#define UPTIME0			10000		/* Uptime at tick 0 */
+#define NLOOPS			200			/* # of loop devices */
+#define NVETHS			100			/* # of container interfaces */
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+char *		dir;				/* The fixture directory			*/
+long		tick		= 0;	/* # of ticks since creation		*/
+int			nextpid		= 300;	/* Next pid to hand out				*/
+unsigned	seed		= 1;	/* Random seed, saved in DIR/state	*/
+
+char * comms[] = {
+	"bash", "sshd", "java", "postgres", "nginx", "cc1", "ld", "make",
+	"python3", "systemd", "kworker/0:1", "cron", "rsyslogd", "containerd",
+	"dockerd", "node"
+};
+#define NCOMMS	(sizeof (comms) / sizeof (comms[0]))
+
+char * users[] = { "root", "build", "www-data", "postgres", "geertj" };
+int uids[] = { 0, 1001, 33, 114, 1000 };
+#define NUSERS	(sizeof (users) / sizeof (users[0]))
+
+char * files[] = { "stat", "status", "cmdline", "cgroup", "io", 
+		"smaps_rollup", NULL };
+
+/* ------------------------------------------------------------------------
+ * Prototypes */
+
+unsigned	hash		(unsigned);
+int			busy		(int);
+long		born		(int);
+FILE *		xfopen		(const char *, ...);
+void		write_proc	(int, long);
+void		write_stat	(int, long);
+void		write_io	(int, long);
+void		write_system(int);
+void		remove_proc	(int);
+void		save_state	(void);
+int			load_state	(void);
+int			create		(int);
+int			mutate		(void);
+
+/* ------------------------------------------------------------------------
+ * hash: Integer hash, used to derive stable per-process properties. */
+
+unsigned hash( unsigned x)
+{
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	return ((x >> 16) ^ x);
+}
+
+/* ------------------------------------------------------------------------
+ * busy: Return the # of jiffies process `pid' uses per tick. */
+
+int busy( int pid)
+{
+	unsigned h = hash( pid);
+
+	return ((h % 10) ? 0 : 1 + (h >> 8) % 60);
+}
+
+/* ------------------------------------------------------------------------
+ * born: Return the tick at which process `pid' was born, from the start
+ * time in its stat file. */
+
+long born( int pid)
+{
+	char fname[FILENAME_MAX];
+	unsigned long starttime;
+	FILE * f;
+
+	sprintf( fname, "%s/proc/%d/stat", dir, pid);
+	if (!(f = fopen( fname, "r")))
+		return (tick);
+	if (fscanf( f, "%*d (%*[^)]) %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u "
+			"%*u %*u %*u %*d %*d %*d %*d %*d %*d %lu", &starttime) != 1)
+		starttime = (UPTIME0 + tick) * HZ;
+	fclose( f);
+	return (starttime / HZ - UPTIME0);
+}
+
+/* ------------------------------------------------------------------------
+ * xfopen: Open the file with printf-style name below `dir' for writing,
+ * exit on failure. */
+
+FILE * xfopen( const char * fmt, ...)
+{
+	char fname[FILENAME_MAX];
+	int len;
+	va_list args;
+	FILE * f;
+
+	len = sprintf( fname, "%s/", dir);
+	va_start( args, fmt);
+	vsnprintf( fname+len, FILENAME_MAX-len, fmt, args);
+	va_end( args);
+
+	if (!(f = fopen( fname, "w"))) {
+		perror( fname);
+		exit( 1);
+	}
+	return (f);
+}
+
+/* ------------------------------------------------------------------------
+ * write_stat: Write proc/<pid>/stat for a process born at tick `birth'. */
+
+void write_stat( int pid, long birth)
+{
+	unsigned h = hash( pid);
+	unsigned long utime, stime, vsize, rss;
+	char * comm;
+	char state;
+	FILE * f;
+
+	comm = comms[h % NCOMMS];
+	utime = busy( pid) * (tick - birth) * 3 / 4;
+	stime = busy( pid) * (tick - birth) / 4;
+	state = busy( pid) ? 'R' : (((h >> 4) % 50) ? 'S' : 'D');
+	vsize = (4096UL + (h >> 6) % (1024 * 1024)) * 1024;
+	rss = vsize / PAGESIZE / (2 + (h >> 3) % 8);
+
+	f = xfopen( "proc/%d/stat", pid);
+	fprintf( f, "%d (%s) %c %d %d %d 0 -1 4194560 %lu 0 %lu 0 %lu %lu 0 0 "
+			"20 0 %d 0 %ld %lu %lu 18446744073709551615 1 1 0 0 0 0 0 0 0 "
+			"0 0 0 17 %d 0 0 %lu 0 0 0 0 0 0 0 0 0 0\n",
+			pid, comm, state, (h >> 2) % 2 ? 1 : pid - 1, pid, pid,
+			(tick - birth) * 40, (tick - birth) / 10, utime, stime,
+			1 + (h >> 5) % 32, (UPTIME0 + birth) * HZ, vsize, rss,
+			(h >> 7) % NCPUS, (tick - birth) / 50);
+	fclose( f);
+}
+
+/* ------------------------------------------------------------------------
+ * write_io: Write proc/<pid>/io for a process born at tick `birth'. Busy
+ * processes read and write some kilobytes per tick, one in eight of them
+ * a lot more. */
+
+void write_io( int pid, long birth)
+{
+	unsigned h = hash( pid);
+	unsigned long rd, wr;
+	FILE * f;
+
+	rd = busy( pid) * (tick - birth) * (h % 8 ? 4096 : 1048576);
+	wr = busy( pid) * (tick - birth) * ((h >> 3) % 8 ? 1024 : 262144);
+
+	f = xfopen( "proc/%d/io", pid);
+	fprintf( f, "rchar: %lu\nwchar: %lu\nsyscr: %lu\nsyscw: %lu\n"
+			"read_bytes: %lu\nwrite_bytes: %lu\ncancelled_write_bytes: 0\n",
+			rd * 2, wr, rd / 4096 + tick, wr / 4096 + tick, rd, wr);
+	fclose( f);
+}
+
+/* ------------------------------------------------------------------------
+ * write_proc: Create proc/<pid> for a process born at tick `birth'. */
+
+void write_proc( int pid, long birth)
+{
+	char fname[FILENAME_MAX];
+	unsigned h = hash( pid);
+	char * comm, * user;
+	unsigned long rss, shared;
+	int uid;
+	FILE * f;
+
+	comm = comms[h % NCOMMS];
+	user = users[(h >> 3) % NUSERS];
+	uid = uids[(h >> 3) % NUSERS];
+
+	sprintf( fname, "%s/proc/%d", dir, pid);
+	if (mkdir( fname, 0755) && (errno != EEXIST)) {
+		perror( fname);
+		exit( 1);
+	}
+	write_stat( pid, birth);
+	write_io( pid, birth);
+
+	/* Processes with the same name share some of their pages, as forked
+	 * workers do */
+
+	rss = (4096UL + (h >> 6) % (1024 * 1024)) / (2 + (h >> 3) % 8);
+	shared = rss * ((h >> 9) % 4) / 4;
+	f = xfopen( "proc/%d/smaps_rollup", pid);
+	fprintf( f, "55d4c0a00000-7ffd2c1ff000 ---p 00000000 00:00 0    "
+			"[rollup]\nRss:            %8lu kB\nPss:            %8lu kB\n"
+			"Pss_Anon:       %8lu kB\nShared_Clean:   %8lu kB\n"
+			"Shared_Dirty:          0 kB\nPrivate_Clean:  %8lu kB\n"
+			"Private_Dirty:  %8lu kB\nReferenced:     %8lu kB\n"
+			"Swap:                  0 kB\n", rss, rss - shared + shared / 
+			(1 + (h >> 11) % 16), rss - shared, shared, (rss - shared) / 4,
+			(rss - shared) - (rss - shared) / 4, rss);
+	fclose( f);
+
+	f = xfopen( "proc/%d/status", pid);
+	fprintf( f, "Name:\t%s\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t%d\n"
+			"Ngid:\t0\nPid:\t%d\nPPid:\t1\nTracerPid:\t0\n"
+			"Uid:\t%d\t%d\t%d\t%d\nGid:\t%d\t%d\t%d\t%d\nFDSize:\t64\n"
+			"Groups:\t%d\nVmPeak:\t   12345 kB\nVmSize:\t   12345 kB\n"
+			"VmRSS:\t    4567 kB\nThreads:\t%d\n"
+			"voluntary_ctxt_switches:\t%ld\n"
+			"nonvoluntary_ctxt_switches:\t%ld\n",
+			comm, pid, pid, uid, uid, uid, uid, uid, uid, uid, uid, uid,
+			1 + (h >> 5) % 32, tick * 10, tick);
+	fclose( f);
+
+	f = xfopen( "proc/%d/cmdline", pid);
+	fprintf( f, "/usr/bin/%s%c--user=%s%c--worker=%d%c", comm, 0, user, 0,
+			pid, 0);
+	fclose( f);
+
+	f = xfopen( "proc/%d/cgroup", pid);
+	if (!strcmp( comm, "java") || !strcmp( comm, "node"))
+		fprintf( f, "0::/system.slice/docker-%08x.scope\n", hash( h) % 64);
+	else
+		fprintf( f, "0::/system.slice/%s.service\n", comm);
+	fclose( f);
+}
+
+/* ------------------------------------------------------------------------
+ * remove_proc: Remove proc/<pid>. */
+
+void remove_proc( int pid)
+{
+	char fname[FILENAME_MAX];
+	int i;
+
+	for (i=0; files[i]; i++) {
+		sprintf( fname, "%s/proc/%d/%s", dir, pid, files[i]);
+		unlink( fname);
+	}
+	sprintf( fname, "%s/proc/%d", dir, pid);
+	rmdir( fname);
+}
+
+/* ------------------------------------------------------------------------
+ * write_system: Write the system wide files for `nprocs' processes. */
+
+void write_system( int nprocs)
+{
+	unsigned long user, system, idle, free;
+	FILE * f;
+	int i;
+
+	user = tick * HZ * NCPUS * 3 / 10;
+	system = tick * HZ * NCPUS / 10;
+	idle = tick * HZ * NCPUS - user - system;
+	free = MEMTOTAL / 4 + hash( tick) % (MEMTOTAL / 8);
+
+	f = xfopen( "proc/uptime");
+	fprintf( f, "%ld.%02d %ld.%02d\n", UPTIME0 + tick, 0, (UPTIME0 + tick) *
+			NCPUS * 6 / 10, 0);
+	fclose( f);
+
+	f = xfopen( "proc/stat");
+	fprintf( f, "cpu  %lu 0 %lu %lu 0 0 0 0 0 0\n", user, system, idle);
+	for (i=0; i<NCPUS; i++)
+		fprintf( f, "cpu%d %lu 0 %lu %lu 0 0 0 0 0 0\n", i, user / NCPUS,
+				system / NCPUS, idle / NCPUS);
+	fprintf( f, "intr 0\nctxt %ld\nbtime 850000000\nprocesses %d\n"
+			"procs_running %d\nprocs_blocked 0\nsoftirq 0\n", tick * 5000,
+			nextpid, 1 + nprocs / 10);
+	fclose( f);
+
+	f = xfopen( "proc/loadavg");
+	fprintf( f, "%.2f %.2f %.2f %d/%d %d\n", (hash( tick) % 400) / 100.0,
+			1.5, 1.2, 1 + nprocs / 10, nprocs, nextpid);
+	fclose( f);
+
+	f = xfopen( "proc/meminfo");
+	fprintf( f, "MemTotal:       %lu kB\nMemFree:        %lu kB\n"
+			"MemAvailable:   %lu kB\nBuffers:        %lu kB\n"
+			"Cached:         %lu kB\nSwapCached:     0 kB\n"
+			"Active:         %lu kB\nInactive:       %lu kB\n"
+			"SwapTotal:      %lu kB\nSwapFree:       %lu kB\n"
+			"Dirty:          128 kB\nShmem:          1024 kB\n",
+			MEMTOTAL, free, free * 2, MEMTOTAL / 64, MEMTOTAL / 8,
+			MEMTOTAL / 3, MEMTOTAL / 5, MEMTOTAL / 4, MEMTOTAL / 4 - tick);
+	fclose( f);
+
+	/* Two busy disks with a partition each, and many idle loop devices
+	 * as on a container host */
+
+	f = xfopen( "proc/diskstats");
+	for (i=0; i<NLOOPS; i++)
+		fprintf( f, "   7 %7d loop%d 12 0 96 1 0 0 0 0 0 4 1 0 0 0 0 0 0\n",
+				i, i);
+	for (i=0; i<2; i++) {
+		fprintf( f, "%4d %7d %s %lu 0 %lu %lu %lu 0 %lu %lu 0 %lu %lu "
+				"0 0 0 0 0 0\n", i ? 259 : 8, 0, i ? "nvme0n1" : "sda", 
+				tick * 150 * (i+1), tick * 2400 * (i+1), tick * 300, 
+				tick * 80 * (i+1), tick * 1600 * (i+1), tick * 400, 
+				tick * 450, tick * 900);
+		fprintf( f, "%4d %7d %s %lu 0 %lu %lu %lu 0 %lu %lu 0 %lu %lu "
+				"0 0 0 0 0 0\n", i ? 259 : 8, 1, i ? "nvme0n1p1" : "sda1",
+				tick * 150 * (i+1), tick * 2400 * (i+1), tick * 300, 
+				tick * 80 * (i+1), tick * 1600 * (i+1), tick * 400, 
+				tick * 450, tick * 900);
+	}
+	fclose( f);
+
+	/* A busy uplink that drops packets, an idle second one and the
+	 * veth ends of many containers */
+
+	f = xfopen( "proc/net/dev");
+	fprintf( f, "Inter-|   Receive                                          "
+			"      |  Transmit\n face |bytes    packets errs drop fifo "
+			"frame compressed multicast|bytes    packets errs drop fifo "
+			"colls carrier compressed\n");
+	fprintf( f, "    lo: %lu %lu 0 0 0 0 0 0 %lu %lu 0 0 0 0 0 0\n",
+			tick * 20000, tick * 100, tick * 20000, tick * 100);
+	fprintf( f, "  eth0: %lu %lu %lu %lu 0 0 0 0 %lu %lu 0 %lu 0 0 0 0\n",
+			tick * 12000000, tick * 9000, tick / 10, tick * 3, 
+			tick * 4000000, tick * 6000, tick);
+	fprintf( f, "  eth1: 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0\n");
+	for (i=0; i<NVETHS; i++)
+		fprintf( f, "veth%04x: %lu %lu 0 0 0 0 0 0 %lu %lu 0 0 0 0 0 0\n",
+				i, tick * (i % 7) * 1000, tick * (i % 7), 
+				tick * (i % 5) * 1000, tick * (i % 5));
+	fclose( f);
+
+	f = xfopen( "proc/net/snmp");
+	fprintf( f, "Ip: Forwarding DefaultTTL InReceives\nIp: 1 64 %lu\n"
+			"Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens "
+			"PassiveOpens AttemptFails EstabResets CurrEstab InSegs OutSegs "
+			"RetransSegs InErrs OutRsts InCsumErrors\n"
+			"Tcp: 1 200 120000 -1 %lu %lu %lu %lu 40 %lu %lu %lu 0 %lu 0\n"
+			"Udp: InDatagrams NoPorts\nUdp: %lu 0\n",
+			tick * 9000, tick * 2, tick * 50, tick, tick * 2, tick * 9000,
+			tick * 6000, tick * 60, tick * 5, tick * 100);
+	fclose( f);
+
+	/* Some memory pressure, and the paging that goes with it */
+
+	for (i=0; i<3; i++) {
+		f = xfopen( "proc/pressure/%s", i == 0 ? "cpu" : 
+				i == 1 ? "memory" : "io");
+		fprintf( f, "some avg10=%.2f avg60=%.2f avg300=%.2f total=%lu\n"
+				"full avg10=%.2f avg60=%.2f avg300=%.2f total=%lu\n",
+				(hash( tick + i) % 2000) / 100.0, 5.0, 4.0, tick * 100000,
+				(hash( tick + i) % 500) / 100.0, 1.0, 0.5, tick * 20000);
+		fclose( f);
+	}
+
+	f = xfopen( "proc/vmstat");
+	fprintf( f, "nr_free_pages %lu\npgpgin %lu\npgpgout %lu\n"
+			"pswpin %lu\npswpout %lu\npgfault %lu\npgmajfault %lu\n"
+			"pgsteal_kswapd %lu\npgsteal_direct %lu\npgscan_kswapd %lu\n"
+			"pgscan_direct %lu\npgscan_direct_throttle 0\npgscan_anon 0\n"
+			"oom_kill %lu\n", free / 4, tick * 4000, tick * 2000, tick * 3,
+			tick * 8, tick * 50000, tick * 20, tick * 900, tick * 100, 
+			tick * 1200, tick * 150, tick / 600);
+	fclose( f);
+
+	f = xfopen( "proc/net/netstat");
+	fprintf( f, "TcpExt: SyncookiesSent TW ListenOverflows ListenDrops "
+			"TCPTimeouts\nTcpExt: 0 %lu %lu %lu %lu\n"
+			"IpExt: InNoRoutes InOctets\nIpExt: 0 %lu\n",
+			tick * 40, tick / 4, tick / 4, tick * 2, tick * 12000000);
+	fclose( f);
+}
+
+/* ------------------------------------------------------------------------
+ * save_state, load_state: The state of the fixture is kept in DIR/state. */
+
+void save_state( void)
+{
+	FILE * f;
+
+	f = xfopen( "state");
+	fprintf( f, "%ld %d %u\n", tick, nextpid, seed);
+	fclose( f);
+}
+
+int load_state( void)
+{
+	char fname[FILENAME_MAX];
+	FILE * f;
+
+	sprintf( fname, "%s/state", dir);
+	if (!(f = fopen( fname, "r"))) {
+		perror( fname);
+		return (1);
+	}
+	if (fscanf( f, "%ld %d %u", &tick, &nextpid, &seed) != 3) {
+		fprintf( stderr, "%s: ? format\n", fname);
+		fclose( f);
+		return (1);
+	}
+	fclose( f);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * create: Create a new fixture with `nprocs' processes. */
+
+int create( int nprocs)
+{
+	char fname[FILENAME_MAX];
+	char * sub[] = { "", "/proc", "/proc/self", "/proc/net", 
+			"/proc/pressure", "/mnt", "/mnt/data", "/mnt/home", NULL };
+	struct utmp ut;
+	FILE * f;
+	int i;
+
+	for (i=0; sub[i]; i++) {
+		sprintf( fname, "%s%s", dir, sub[i]);
+		if (mkdir( fname, 0755) && (errno != EEXIST)) {
+			perror( fname);
+			return (1);
+		}
+	}
+
+	tick = 0;
+	for (i=0; i<nprocs; i++)
+		write_proc( nextpid++, -(long) (hash( i) % UPTIME0));
+	write_system( nprocs);
+
+	f = xfopen( "proc/version");
+	fprintf( f, "Linux version 2.0.30 (fixture@mkfixture) #1 Mon Nov 10 "
+			"1997\n");
+	fclose( f);
+
+	f = xfopen( "proc/mounts");
+	fprintf( f, "/dev/sda1 / ext2 rw 0 0\nproc /proc proc rw 0 0\n"
+			"/dev/sda2 %s/mnt/data ext2 rw 0 0\n"
+			"server:/home %s/mnt/home nfs rw 0 0\n", dir, dir);
+	for (i=0; i<nprocs / 100; i++)
+		fprintf( f, "overlay /var/lib/docker/overlay2/%08x/merged overlay "
+				"rw 0 0\n", hash( i));
+	fclose( f);
+	sprintf( fname, "%s/proc/self/mounts", dir);
+	unlink( fname);
+	symlink( "../mounts", fname);
+
+	f = xfopen( "utmp");
+	for (i=0; i<3 + nprocs / 1000; i++) {
+		memset( &ut, 0, sizeof (ut));
+		ut.ut_type = USER_PROCESS;
+		ut.ut_pid = 300 + i;
+		snprintf( ut.ut_line, sizeof (ut.ut_line), "pts/%d", i);
+		strncpy( ut.ut_user, users[i % NUSERS], sizeof (ut.ut_user));
+		strncpy( ut.ut_host, (i % 3) ? "client.example.org" : ":0",
+				sizeof (ut.ut_host));
+		fwrite( &ut, sizeof (ut), 1, f);
+	}
+	fclose( f);
+
+	save_state();
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * mutate: Advance the fixture by one tick. */
+
+int mutate( void)
+{
+	char fname[FILENAME_MAX];
+	struct dirent * dentry;
+	int pid, nprocs, nexit;
+	long birth;
+	DIR * procdir;
+
+	if (load_state())
+		return (1);
+	tick++;
+	srand( seed++);
+
+	sprintf( fname, "%s/proc", dir);
+	if (!(procdir = opendir( fname))) {
+		perror( fname);
+		return (1);
+	}
+	nprocs = nexit = 0;
+	while ((dentry = readdir( procdir))) {
+		if (!(pid = atoi( dentry->d_name)))
+			continue;
+		nprocs++;
+		if (!(rand() % 100)) {
+			remove_proc( pid);
+			nexit++;
+		} else if (busy( pid)) {
+			birth = born( pid);
+			write_stat( pid, birth);
+			write_io( pid, birth);
+		}
+	}
+	closedir( procdir);
+
+	/* Keep the number of processes constant */
+
+	while (nexit--)
+		write_proc( nextpid++, tick);
+	write_system( nprocs);
+
+	save_state();
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * main */
+
+int main( int argc, char ** argv)
+{
+	int c, nprocs = 1000, mflag = 0;
+
+	while ((c = getopt( argc, argv, "mn:s:")) != EOF) {
+		switch (c) {
+		case 'm':
+			mflag = 1;
+			break;
+		case 'n':
+			nprocs = atoi( optarg);
+			break;
+		case 's':
+			seed = atoi( optarg);
+			break;
+		default:
+			fprintf( stderr, "Usage: mkfixture [-n NPROCS] [-s SEED] DIR\n"
+					"       mkfixture -m DIR\n");
+			exit( 1);
+		}
+	}
+	if (optind != argc-1) {
+		fprintf( stderr, "mkfixture: no directory given\n");
+		exit( 1);
+	}
+	dir = argv[optind];
+
+	return (mflag ? mutate() : create( nprocs));
+}
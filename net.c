@@ -0,0 +1,300 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * net.c: Per-interface traffic from /proc/net/dev and TCP health counters
+ * from /proc/net/snmp and /proc/net/netstat. Each file is read with one
+ * system call into the same buffer, and parsed where it lies. The rates
+ * are computed from the counter deltas between two updates.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int					nnets			= 0;	/* # of entries in net table */
+int					nets_size		= 16;	/* initial net table size	*/
+int					net_dev_fd		= -1;	/* open /proc/net/dev		*/
+int					net_snmp_fd		= -1;	/* open /proc/net/snmp		*/
+int					net_netstat_fd	= -1;	/* open /proc/net/netstat	*/
+int					net_bufsize		= 0;	/* size of net_buf			*/
+int					net_serial		= 0;	/* # of net updates			*/
+char *				net_buf			= NULL;	/* contents of a net file	*/
+
+struct net_info *	nets			= NULL;	/* all interfaces			*/
+struct tcp_stats	tcpstats;					/* TCP counters and rates	*/
+
+/* Interfaces that are shown: all but loopback by default */
+
+char *	netinclude	= "*";
+char *	netexclude	= "lo";
+
+/* The TCP counters we use, in TCP_* order, by their line in the file */
+
+char *	tcp_names[]		= { "RetransSegs", "OutSegs", "OutRsts",
+							"EstabResets", NULL };
+char *	tcpext_names[]	= { "ListenOverflows", "ListenDrops", NULL };
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+struct net_info *	net_lookup	(int, const char *, int);
+int			net_comp			(const int *, const int *);
+int			read_netdev			(double);
+int			read_tcp			(double);
+int			snmp_parse			(char *, const char *, char **,
+								 unsigned long long *);
+
+/* ------------------------------------------------------------------------
+ * net_lookup: Find an interface in the net table, add it if it is new. The
+ * interfaces are in the same order in every read, so the entry at `hint'
+ * is tried first. */
+
+struct net_info * net_lookup( int hint, const char * name, int len)
+{
+	struct net_info * n;
+	int i;
+
+	if ((hint < nnets) && !strncmp( nets[hint].name, name, len) &&
+			!nets[hint].name[len])
+		return (nets + hint);
+	for (i=0; i<nnets; i++)
+		if (!strncmp( nets[i].name, name, len) && !nets[i].name[len])
+			return (nets + i);
+
+	if (nnets == nets_size)
+		nets = xrealloc( nets, (nets_size *= 2) * sizeof (struct net_info));
+	n = nets + nnets++;
+	memset( n, 0, sizeof (struct net_info));
+	if (len >= NET_NAME_SIZE)
+		len = NET_NAME_SIZE-1;
+	memcpy( n->name, name, len);
+	n->name[len] = '\000';
+	n->shown = match_list( netinclude, n->name) &&
+			!match_list( netexclude, n->name);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * read_netdev: Read /proc/net/dev and update the rates of the interfaces
+ * that are shown. `now' is the time of this update. */
+
+int read_netdev( double now)
+{
+	char fname[FILENAME_MAX];
+	char * p, * q, * name;
+	int i, n, len;
+	double dt, dv[NET_NFIELDS];
+	unsigned long long v[NET_NFIELDS];
+	struct net_info * d;
+
+	sprintf( fname, "%s/net/dev", procroot);
+	if (readfile( fname, &net_dev_fd, &net_buf, &net_bufsize) == -1) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+		return (1);
+	}
+	net_serial++;
+
+	/* Two header lines, then "name: counters" */
+
+	for (p=net_buf, n=-2; *p; p=q, n++) {
+		if ((q = strchr( p, '\n')))
+			*q++ = '\000';
+		else
+			q = p + strlen( p);
+		if ((n < 0) || !(p = strchr( name = p, ':')))
+			continue;
+		name += strspn( name, " ");
+		if (!(len = p - name))
+			continue;
+		d = net_lookup( n, name, len);
+		d->serial = net_serial;
+		if (!d->shown)
+			continue;
+
+		p++;
+		for (i=0; i<NET_NFIELDS; i++)
+			v[i] = strtoull( p, &p, 10);
+
+		/* A counter that went back belongs to a new interface with the
+		 * same name. */
+
+		dt = now - d->t;
+		if (d->t && (dt > 0)) {
+			for (i=0; i<NET_NFIELDS; i++)
+				dv[i] = (v[i] >= d->v[i]) ? v[i] - d->v[i] : 0;
+			d->rbytes = dv[ND_RX_BYTES] / dt;
+			d->tbytes = dv[ND_TX_BYTES] / dt;
+			d->rpkts = dv[ND_RX_PACKETS] / dt;
+			d->tpkts = dv[ND_TX_PACKETS] / dt;
+			d->errs = (dv[ND_RX_ERRS] + dv[ND_TX_ERRS]) / dt;
+			d->drops = (dv[ND_RX_DROP] + dv[ND_TX_DROP]) / dt;
+		}
+		memcpy( d->v, v, sizeof (v));
+		d->t = now;
+	}
+
+	/* Remove interfaces that are gone */
+
+	for (i=0; i<nnets; i++)
+		if (nets[i].serial != net_serial)
+			nets[i--] = nets[--nnets];
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * snmp_parse: Find the counters in `names' in `buf', which holds a file
+ * like /proc/net/snmp. There, every `prefix' line with counter names is
+ * followed by one with their values. The values found are stored in `v',
+ * the others are left alone. Returns nonzero if `prefix' is not there. */
+
+int snmp_parse( char * buf, const char * prefix, char ** names,
+		unsigned long long * v)
+{
+	char * p, * q;
+	int i, len, plen;
+
+	plen = strlen( prefix);
+	for (p=buf; p && strncmp( p, prefix, plen); )
+		if ((p = strchr( p, '\n')))
+			p++;
+	if (!p || !(q = strchr( p, '\n')) || strncmp( ++q, prefix, plen))
+		return (1);
+
+	/* Walk the names in `p' and the values in `q' side by side */
+
+	p += plen;
+	q += plen;
+	for (;;) {
+		p += strspn( p, " ");
+		if (!(len = strcspn( p, " \n")))
+			break;
+		for (i=0; names[i]; i++)
+			if (!strncmp( names[i], p, len) && !names[i][len])
+				break;
+		if (names[i])
+			v[i] = strtoull( q, &q, 10);
+		else
+			strtoll( q, &q, 10);
+		p += len;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_tcp: Read the TCP counters from /proc/net/snmp and /proc/net/netstat
+ * and update their rates. `now' is the time of this update. */
+
+int read_tcp( double now)
+{
+	char fname[FILENAME_MAX];
+	unsigned long long v[TCP_NFIELDS];
+	double dt, dv[TCP_NFIELDS];
+	struct tcp_stats * t = &tcpstats;
+	int i;
+
+	memcpy( v, t->v, sizeof (v));
+	sprintf( fname, "%s/net/snmp", procroot);
+	if ((readfile( fname, &net_snmp_fd, &net_buf, &net_bufsize) == -1) ||
+			snmp_parse( net_buf, "Tcp:", tcp_names, v)) {
+		t->ok = 0;
+		return (1);
+	}
+
+	/* netstat is not there on old kernels; the rates stay zero then */
+
+	sprintf( fname, "%s/net/netstat", procroot);
+	if (readfile( fname, &net_netstat_fd, &net_buf, &net_bufsize) != -1)
+		snmp_parse( net_buf, "TcpExt:", tcpext_names, v + TCP_LISTEN_OVF);
+
+	dt = now - t->t;
+	if (t->t && (dt > 0)) {
+		for (i=0; i<TCP_NFIELDS; i++)
+			dv[i] = (v[i] >= t->v[i]) ? v[i] - t->v[i] : 0;
+		for (i=0; i<TCP_NFIELDS; i++)
+			t->rate[i] = dv[i] / dt;
+		t->pct_retrans = dv[TCP_OUT_SEGS] ?
+				dv[TCP_RETRANS] * 100 / dv[TCP_OUT_SEGS] : 0;
+	}
+	memcpy( t->v, v, sizeof (v));
+	t->t = now;
+	t->ok = 1;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_net: Update the interface and TCP rates. Only done while the
+ * network page is shown. */
+
+int read_net( void)
+{
+	double now;
+
+	if (page != PAGE_NET)
+		return (0);
+	now = mono_time();
+	read_netdev( now);
+	read_tcp( now);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * net_comp: Compare two interfaces according to `netsort'. Used with
+ * qsort(). */
+
+int net_comp( const int * one, const int * two)
+{
+	struct net_info * a = nets + *one, * b = nets + *two;
+	double ka, kb;
+
+	switch (netsort) {
+	case NETSORT_PACKETS:
+		ka = a->rpkts + a->tpkts;
+		kb = b->rpkts + b->tpkts;
+		break;
+	case NETSORT_DROPS:
+		ka = a->drops + a->errs;
+		kb = b->drops + b->errs;
+		break;
+	case NETSORT_BYTES:
+	default:
+		ka = a->rbytes + a->tbytes;
+		kb = b->rbytes + b->tbytes;
+		break;
+	}
+	return ((ka < kb) - (ka > kb));
+}
+
+/* ------------------------------------------------------------------------
+ * net_sort: Store the indices of the top `max' shown interfaces in `top'.
+ * Returns the number of interfaces stored. */
+
+int net_sort( int * top, int max)
+{
+	int i, n;
+	int * all;
+
+	all = xmalloc( (nnets + 1) * sizeof (int));
+	for (i=n=0; i<nnets; i++)
+		if (nets[i].shown)
+			all[n++] = i;
+	qsort( all, n, sizeof (int),
+			(int (*)(const void *, const void *)) net_comp);
+	if (n > max)
+		n = max;
+	memcpy( top, all, n * sizeof (int));
+	free( all);
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * net_init: Allocate the net table. */
+
+int net_init( void)
+{
+	nets = xmalloc( nets_size * sizeof (struct net_info));
+	memset( &tcpstats, 0, sizeof (tcpstats));
+	return (0);
+}
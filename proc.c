@@ -9,14 +9,23 @@
 /* ------------------------------------------------------------------------
  * Globals: it's allways a good thing to initialise them */
 
-int		jiffies 		= 0; 	/* # of ticks since last update		*/
-int		totaljiffies 	= 0;	/* system's total ticks				*/
+double	jiffies 		= 0; 	/* # of ticks since the source ran	*/
+double	update_t	 	= 0;	/* time of this update				*/
+long	clk_tck			= HZ;	/* ticks per second, from sysconf()	*/
 int 	procs_maxi		= 0;	/* maximum index in process table	*/
 int	 	procs_size		= 32;	/* initial process table size		*/
 int		nlogins			= 0;	/* # of entry's in utmp				*/
 int		logins_size		= 32;	/* initial login table size			*/
 int		nwchans			= 0;	/* # of symbols in symbol table		*/
 int		wchans_size		= 32;	/* initial entry's malloced			*/
+int		procs_free		= 0;	/* lowest index that may be free	*/
+int		runq_ncpus		= 0;	/* # of CPUs in runq_old			*/
+int		schedstat_fd	= -1;	/* open /proc/schedstat				*/
+int		schedstat_size	= 0;	/* size of schedstat_buf			*/
+char *	schedstat_buf	= NULL;	/* contents of /proc/schedstat		*/
+double	runq_t			= 0;	/* time it was last read			*/
+unsigned long long *	runq_old = NULL;	/* run_delay per CPU	*/
+int		pidhash[PID_HASH_SIZE];	/* process table hash chains		*/
 
 double 	loads[3]		= { 0, 0, 0};			/* load averages	*/
 
@@ -30,12 +39,9 @@ struct wchan_entry * 	wchans		= NULL;		/* all wchan's		*/
 /* ------------------------------------------------------------------------
  * Function prototypes */
 
-int			read_procs			(void);
-int			read_loads			(void);
-int 		read_cpu			(void);
-int			read_mem			(void);
-int			read_logins			(void);
-int			check_diskfree		(void);
+int			read_io				(struct process_info *);
+int			read_pss			(struct process_info *);
+int			read_sched			(struct process_info *);
 void 		update_jiffies		(void);
 
 const char *	strwchan		(unsigned long);
@@ -72,29 +78,33 @@ int read_logins( void)
 
 
 /* ------------------------------------------------------------------------
- * update_jiffies: Update jiffies and totaljiffies counters. Jiffies is the
- * number of ticks since the last update, totaljiffies is the system's 
- * total. */
+ * update_jiffies: Take the time of this update, from which each source
+ * gets the number of ticks since it last ran. The time comes from the
+ * monotonic clock, so it is exact instead of a whole number of ticks. In
+ * benchmark mode the data is made up between updates, and so is the time:
+ * it is read from uptime. */
 
 void update_jiffies( void)
 {
+	char fname[FILENAME_MAX];
 	FILE * statfile;
-	int i;
-
-	if (!(statfile = fopen( "/proc/uptime", "r"))) {
-		queue_msg( MAX_PRIO, "/proc/uptime: %s", strerror( errno));
-		return;
-	}
-	if (fscanf( statfile, "%d.%d", &i, &jiffies) != 2) {
-		queue_msg( MAX_PRIO, "/proc/uptime: ? format");
+	double now;
+
+	now = mono_time();
+	if (bench) {
+		sprintf( fname, "%s/uptime", procroot);
+		if (!(statfile = fopen( fname, "r"))) {
+			queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+			return;
+		}
+		if (fscanf( statfile, "%lf", &now) != 1) {
+			queue_msg( MAX_PRIO, "%s: ? format", fname);
+			fclose( statfile);
+			return;
+		}
 		fclose( statfile);
-		return;
 	}
-	fclose( statfile);
-	jiffies += i*HZ;
-	i = jiffies;
-	jiffies -= totaljiffies;
-	totaljiffies = i;
+	update_t = now;
 }
 
 /* ------------------------------------------------------------------------
@@ -109,8 +119,10 @@ int read_procs( void)
 {
 	char statname[FILENAME_MAX];
 	char buf[BUFSIZ];
-	int i, j, k, pid, found;
-	unsigned long utime, stime;
+	int i, j, k, h, pid, seen;
+	unsigned long utime, stime, minflt, majflt, nvcsw, nivcsw;
+	unsigned long long blkio;
+	double t, t0;
 	struct dirent * dentry;
 	struct passwd * pwd;
 	FILE * statfile;
@@ -119,74 +131,144 @@ int read_procs( void)
 	static int serial = 0;
 
 	serial++;
-	if (!(procdir = opendir( "/proc"))) {
-		queue_msg( MAX_PRIO, "/proc/: %s", strerror( errno));
+	if (!(procdir = opendir( procroot))) {
+		queue_msg( MAX_PRIO, "%s: %s", procroot, strerror( errno));
 		return (1);
 	}
+	window_update();
+
+	/* The time spent on each kind of read is accounted to a sub stage.
+	 * Time spent on a process that is skipped goes to the next readdir. */
+
+	t = mono_time();
 	while ((dentry = readdir( procdir))) {
+		t = prof_lap( STAGE_READDIR, t);
 		if (!(pid = atoi( dentry->d_name))) 
 			continue;
-		found = 0;
-		for (i=0; i<procs_maxi; i++) {
-			if (pid == procs[i].pid) {
-				found = 1;
+
+		/* Look the process up in the pid hash. New processes take the
+		 * first free slot. */
+
+		h = pid & (PID_HASH_SIZE-1);
+		for (i=pidhash[h]; i != -1; i=procs[i].hnext)
+			if (pid == procs[i].pid)
 				break;
-			}
-		}
 
-		if (!found) {
-			for (i=0; i<procs_maxi && procs[i].pid; i++);
+		if (i == -1) {
+			for (i=procs_free; i<procs_maxi && procs[i].pid; i++);
 			if (i == procs_maxi) {
 				if (i == procs_size)
 					procs = xrealloc( procs, (procs_size *= 2) * sizeof
 							(struct process_info));
 				i = procs_maxi++;
 			}
+			procs_free = i+1;
 			memset( procs+i, 0, sizeof (struct process_info));
 			procs[i].pid = pid;
+			procs[i].cgroup = -1;
+			procs[i].hist_cpu = procs[i].hist_rss = -1;
+			procs[i].agg_user = procs[i].agg_session = -1;
+			procs[i].parent = procs[i].child = procs[i].sibling = -1;
+			procs[i].tree_ppid = -1;
+			procs[i].watched = -1;
+			procs[i].watch_fd = procs[i].watch_sched_fd = -1;
+			procs[i].hnext = pidhash[h];
+			pidhash[h] = i;
 		}
 			
 		/* /proc/<pid>/stat */
 
-		sprintf( statname, "/proc/%d/stat", pid);
+		sprintf( statname, "%s/%d/stat", procroot, pid);
 		if (!(statfile = fopen( statname, "r"))) {
 			queue_msg( MAX_PRIO, "%s: %s", statname, strerror( errno));
 			continue;
 		}
-		if (fscanf( statfile, "%*d (%31[^)]) %c %*d %*d %*d %*d %*d %*u %*u" 
-				"%*u %*u %*u %lu %lu %*d %*d %*d %ld %*d %*d %*u %lu %ld %*u"
-				"%*u %*u %*u %*u %*u %*u %*u %*u %*u %lu %*u %*u",
-		    	procs[i].comm, &procs[i].state, &utime, &stime, 
+		/* The block I/O delay (field 42) is missing on old kernels */
+
+		blkio = 0;
+		if (fscanf( statfile, "%*d (%31[^)]) %c %d %*d %d %*d %*d %*u %lu" 
+				"%*u %lu %*u %lu %lu %*d %*d %*d %ld %*d %*d %*u %lu %ld %*u"
+				"%*u %*u %*u %*u %*u %*u %*u %*u %*u %lu %*u %*u %*d %*d %*u"
+				"%*u %llu",
+		    	procs[i].comm, &procs[i].state, &procs[i].ppid, 
+				&procs[i].session, &minflt, &majflt, &utime, &stime, 
 				&procs[i].priority, &procs[i].vsize, &procs[i].rss, 
-				&procs[i].wchan) != 8)  {
+				&procs[i].wchan, &blkio) < 12)  {
 			queue_msg( MAX_PRIO, "%s: ? format", statname);
 			fclose( statfile);
 			continue;
 		}
 		procs[i].rss *= getpagesize();
 		fclose( statfile);
+		if (procs[i].watched == -1)
+			watch_check( i);
+		t = prof_lap( STAGE_STAT, t);
+
+		/* The CPU time since the last update counts in the windows. A
+		 * process that is new since then used all of its time since. */
+
+		if ((serial > 1) && (utime + stime > procs[i].jiffies))
+			window_add( procs+i, utime + stime - procs[i].jiffies);
+
+		/* The delay and fault rates are over the time since the last
+		 * update, if the process was seen in it */
+
+		seen = (procs[i].serial == serial-1) && (jiffies > 0);
+		procs[i].blkio_rate = (seen && (blkio >= procs[i].blkio)) ? 
+				(blkio - procs[i].blkio) * 100000.0 / (clk_tck * 
+				jiffies) : 0;
+		procs[i].blkio = blkio;
+		procs[i].minflt_rate = (seen && (minflt >= procs[i].minflt)) ? 
+				(minflt - procs[i].minflt) * clk_tck / jiffies : 0;
+		procs[i].minflt = minflt;
+		procs[i].majflt_rate = (seen && (majflt >= procs[i].majflt)) ? 
+				(majflt - procs[i].majflt) * clk_tck / jiffies : 0;
+		procs[i].majflt = majflt;
 
 		procs[i].serial = serial;
 		procs[i].index++;
 		j = (procs[i].index &= 7);
-		procs[i].times[j] = (double) (utime + stime - procs[i].jiffies) 
-				/ jiffies;
+		procs[i].times[j] = (utime + stime - procs[i].jiffies) / jiffies;
+
+		/* A process that is shown is timed in nanoseconds from its
+		 * schedstat, if the kernel has it and it was read about one
+		 * update ago. A few ticks are a large error in a short update. */
+
+		if ((procs[i].top == top_mark) && !procs[i].sched_missing) {
+			t = prof_lap( STAGE_STAT, t);
+			t0 = procs[i].sched_t;
+			if (!read_sched( procs+i) && t0 && 
+					(procs[i].sched_t - t0 < 2 * jiffies / clk_tck))
+				procs[i].times[j] = procs[i].sched_cpu;
+			t = prof_lap( STAGE_SCHED, t);
+		}
 		procs[i].pct_cpu = procs[i].times[j] * WEIGHT_1 + 
 			procs[i].times[(j-1) & 7] * WEIGHT_2 +
 			procs[i].times[(j-2) & 7] * WEIGHT_3;
 		procs[i].jiffies = utime + stime;
+
+		/* Apply the filter as soon as the values it needs are known, so
+		 * that rejected processes skip the remaining reads. */
+
+		procs[i].filtered = 0;
+		if (filter_expr && !filter_match( procs+i, FILTER_STAT)) {
+			procs[i].filtered = 1;
+			continue;
+		}
 		strnzcpy( procs[i].strwchan, strwchan( procs[i].wchan), 
 				PINFO_WCHAN_SIZE);
 
 		/* /proc/<pid>/status */
 
-		sprintf( statname, "/proc/%d/status", pid);
+		sprintf( statname, "%s/%d/status", procroot, pid);
 		if (!(statfile = fopen( statname, "r"))) {
 			queue_msg( MAX_PRIO, "%s: %s", statname, strerror( errno));
 			continue;
 		}
-		for (k=0; k<5; k++)
-			fgets( buf, BUFSIZ, statfile);
+
+		/* The number of lines before Uid: differs between kernels */
+
+		while (fgets( buf, BUFSIZ, statfile) && strncmp( buf, "Uid:", 4));
 		if (sscanf( buf, "Uid: %d %d %d %d", &procs[i].uid, 
 				&procs[i].euid, &procs[i].suid, &procs[i].fsuid) != 4) {
 			queue_msg( MAX_PRIO, "%s: ? format", statname);
@@ -200,15 +282,37 @@ int read_procs( void)
 			fclose( statfile);
 			continue;
 		}
+
+		/* The context switches are the last lines. The whole file was
+		 * read by the first fgets(), so this costs no system calls as long
+		 * as we stop before the end of it. */
+
+		nvcsw = procs[i].nvcsw;
+		nivcsw = procs[i].nivcsw;
+		while (fgets( buf, BUFSIZ, statfile) && 
+				!sscanf( buf, "nonvoluntary_ctxt_switches: %lu", &nivcsw))
+			sscanf( buf, "voluntary_ctxt_switches: %lu", &nvcsw);
+		procs[i].vcsw_rate = (seen && (nvcsw >= procs[i].nvcsw)) ? 
+				(nvcsw - procs[i].nvcsw) * clk_tck / jiffies : 0;
+		procs[i].ivcsw_rate = (seen && (nivcsw >= procs[i].nivcsw)) ? 
+				(nivcsw - procs[i].nivcsw) * clk_tck / jiffies : 0;
+		procs[i].nvcsw = nvcsw;
+		procs[i].nivcsw = nivcsw;
 		fclose( statfile);
+		t = prof_lap( STAGE_STATUS, t);
 		if (!(pwd = getpwuid( procs[i].uid)))
 			sprintf( procs[i].user, "%d", procs[i].uid);
 		else
 			strnzcpy( procs[i].user, pwd->pw_name, PINFO_USER_SIZE);
+		t = prof_lap( STAGE_GETPWUID, t);
+		if (filter_expr && !filter_match( procs+i, FILTER_STATUS)) {
+			procs[i].filtered = 1;
+			continue;
+		}
 
 		/* /proc/<pid>/cmdline */
 
-		sprintf( statname, "/proc/%d/cmdline", pid);
+		sprintf( statname, "%s/%d/cmdline", procroot, pid);
 		if (!(statfile = fopen( statname, "r"))) {
 			queue_msg( MAX_PRIO, "%s: %s", statname, strerror( errno));
 			continue;
@@ -220,19 +324,44 @@ int read_procs( void)
 				procs[i].cmdline[k] = ' ';
 		procs[i].cmdline[j] = '\000';
 		fclose( statfile);
+		t = prof_lap( STAGE_CMDLINE, t);
+		if (filter_expr && !filter_match( procs+i, FILTER_CMDLINE)) {
+			procs[i].filtered = 1;
+			continue;
+		}
+		cgroup_member( procs+i);
+		t = prof_lap( STAGE_CGMEMBER, t);
 	}
+	prof_lap( STAGE_READDIR, t);
 
 	closedir( procdir);
 
-	/* Remove dead processes from the process table */
+	/* Bring the aggregates and the tree of the live processes up to date,
+	 * and remove dead processes from the process table */
 
 	for (i=0; i<procs_maxi; i++)
-		if (procs[i].serial != serial)
+		if (procs[i].pid && (procs[i].serial == serial)) {
+			aggr_update( procs+i);
+			tree_update( i);
+		} else if (procs[i].pid) {
+			for (j=pidhash[h = procs[i].pid & (PID_HASH_SIZE-1)], k=-1;
+					j != i; k=j, j=procs[j].hnext);
+			if (k == -1)
+				pidhash[h] = procs[i].hnext;
+			else
+				procs[k].hnext = procs[i].hnext;
+			aggr_remove( procs+i);
+			tree_remove( i);
+			window_exit( procs+i);
+			watch_stop( i);
 			procs[i].pid = 0;
+			if (i < procs_free)
+				procs_free = i;
+		}
 
 	/* Try to decrement max counter by one ... */
 
-	if (!procs[procs_maxi-1].pid)
+	if (procs_maxi && !procs[procs_maxi-1].pid)
 		procs_maxi--;
 
 	return (0);
@@ -245,14 +374,16 @@ int read_procs( void)
 
 int read_loads( void)
 {
+	char fname[FILENAME_MAX];
 	FILE * statfile;
 
-	if (!(statfile = fopen( "/proc/loadavg", "r"))) {
-		queue_msg( MAX_PRIO, "/proc/loadavg: %s", strerror( errno));
+	sprintf( fname, "%s/loadavg", procroot);
+	if (!(statfile = fopen( fname, "r"))) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
 		return (1);
 	}
 	if (fscanf( statfile, "%lf %lf %lf", loads, loads+1, loads+2) != 3) {
-		queue_msg( MAX_PRIO, "/proc/loadavg: ? format");
+		queue_msg( MAX_PRIO, "%s: ? format", fname);
 		fclose( statfile);
 		return (1);
 	}
@@ -261,51 +392,303 @@ int read_loads( void)
 }
 
 /* ------------------------------------------------------------------------
- * check_diskfree: Check mounted filesystems for free diskspace. Give a
- * message when it drops below `min_diskfree'. Only check selected filesystem 
- * that are meant to be "native" and that are not mounted ro. Native means
- * that you actually use them, not just to access you DOS games. */
+ * proc_lookup: Return the index of `pid' in the process table, or -1. */
 
-int check_diskfree( void)
+int proc_lookup( int pid)
 {
-	char buf[BUFSIZ], device[FILENAME_MAX]; 
-	char mntpoint[FILENAME_MAX], type[1024], rw[1024];
-	char * fstypes[8] = { "ext2", "nfs", "umsdos", NULL };
-	int i, full;
-	struct statfs f;
-	FILE * statfile;
-	
-	/* /proc/mounts is available since kernel version 1.3.64 */
+	int i;
+
+	for (i=pidhash[pid & (PID_HASH_SIZE-1)]; i != -1; i=procs[i].hnext)
+		if (pid == procs[i].pid)
+			return (i);
+	return (-1);
+}
+
+/* ------------------------------------------------------------------------
+ * read_io: Read /proc/<pid>/io of process `p' and update its I/O rates. 
+ * Only the owner and root may read it; other processes are not tried
+ * again. */
 
-	if (version_code < 1003064)
+int read_io( struct process_info * p)
+{
+	char fname[FILENAME_MAX], buf[512], * s;
+	unsigned long long rd, wr, scr, scw;
+	double now, dt;
+	int fd, n;
+
+	sprintf( fname, "%s/%d/io", procroot, p->pid);
+	if ((fd = open( fname, O_RDONLY)) == -1) {
+		p->io_denied = (errno == EACCES);
+		return (1);
+	}
+	n = read( fd, buf, sizeof (buf) - 1);
+	if (n == -1)
+		p->io_denied = (errno == EACCES);
+	close( fd);
+	if (n <= 0)
+		return (1);
+	buf[n] = '\000';
+
+	scr = (s = strstr( buf, "syscr:")) ? strtoull( s+6, NULL, 10) : 0;
+	scw = (s = strstr( buf, "syscw:")) ? strtoull( s+6, NULL, 10) : 0;
+	rd = (s = strstr( buf, "read_bytes:")) ? strtoull( s+11, NULL, 10) : 0;
+	wr = (s = strstr( buf, "\nwrite_bytes:")) ? strtoull( s+13, NULL, 10) : 0;
+
+	now = mono_time();
+	dt = now - p->io_t;
+	if (p->io_t && (dt > 0)) {
+		p->io_rrate = (rd >= p->io_rbytes) ? (rd - p->io_rbytes) / dt : 0;
+		p->io_wrate = (wr >= p->io_wbytes) ? (wr - p->io_wbytes) / dt : 0;
+		p->io_rops = (scr >= p->io_syscr) ? (scr - p->io_syscr) / dt : 0;
+		p->io_wops = (scw >= p->io_syscw) ? (scw - p->io_syscw) / dt : 0;
+	}
+	p->io_rbytes = rd;
+	p->io_wbytes = wr;
+	p->io_syscr = scr;
+	p->io_syscw = scw;
+	p->io_t = now;
+	aggr_update( p);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_procio: Update the I/O rates of the processes, when an I/O sort or
+ * info mode is selected, or the aggregates are sorted on I/O. Reading
+ * /proc/<pid>/io is expensive, so at most IO_BUDGET seconds are spent per
+ * update. The processes that are shown
+ * are read first. The time that is left goes round the process table,
+ * starting where the previous update stopped. The rates are computed
+ * over the time between two reads of a process, however long. */
+
+int read_procio( void)
+{
+	int i, n;
+	double start;
+	struct process_info * p;
+
+	static int cursor = 0, serial = 0;
+
+	if ((sort != SORT_IO_READ) && (sort != SORT_IO_WRITE) && 
+			(info != INFO_IO) && ((page < PAGE_USERS) || 
+			(page > PAGE_SESSIONS) || (aggrsort != AGGSORT_IO)))
 		return (0);
+	serial++;
+	start = mono_time();
+
+	for (i=0; i<nprocs; i++)
+		if ((n = proc_lookup( pids[i])) != -1) {
+			read_io( procs + n);
+			procs[n].io_serial = serial;
+		}
+
+	for (n=0; (n < procs_maxi) && (mono_time() - start < IO_BUDGET); n++) {
+		if (cursor >= procs_maxi)
+			cursor = 0;
+		p = procs + cursor++;
+		if (!p->pid || p->filtered || p->io_denied || 
+				(p->io_serial == serial))
+			continue;
+		read_io( p);
+		p->io_serial = serial;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_pss: Read /proc/<pid>/smaps_rollup of process `p'. The unique set
+ * size is what the process has private: what would be freed if it
+ * exited. Only the owner and root may read it; other processes are not
+ * tried again. */
 
-	if (!(statfile = fopen( "/proc/mounts", "r"))) {
-		queue_msg( MAX_PRIO, "/proc/mounts: %s", strerror( errno));	
+int read_pss( struct process_info * p)
+{
+	char fname[FILENAME_MAX], buf[1024], * s;
+	int fd, n;
+
+	sprintf( fname, "%s/%d/smaps_rollup", procroot, p->pid);
+	if ((fd = open( fname, O_RDONLY)) == -1) {
+		p->pss_denied = (errno == EACCES);
 		return (1);
 	}
-	full = 0;
-	while (fgets( buf, BUFSIZ, statfile)) {
-		if (sscanf( buf, "%s %s %1023s %1023s", device, mntpoint, type, 
-				rw) != 4)
+	n = read( fd, buf, sizeof (buf) - 1);
+	if (n == -1)
+		p->pss_denied = (errno == EACCES);
+	close( fd);
+	if (n <= 0)
+		return (1);
+	buf[n] = '\000';
+
+	p->pss = (s = strstr( buf, "\nPss:")) ? atol( s+5) << 10 : 0;
+	p->uss = (s = strstr( buf, "\nPrivate_Clean:")) ? atol( s+15) << 10 : 0;
+	p->uss += (s = strstr( buf, "\nPrivate_Dirty:")) ? atol( s+15) << 10 : 0;
+	p->pss_t = mono_time();
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_procpss: Update the PSS and USS of the processes, when sorting on
+ * them. The kernel walks all page tables of a process for smaps_rollup,
+ * so like read_procio() this spends at most PSS_BUDGET seconds per
+ * update: on the processes that are shown first, then on the others in
+ * turn. The age of each value is shown. */
+
+int read_procpss( void)
+{
+	int i, n;
+	double start;
+	struct process_info * p;
+
+	static int cursor = 0, serial = 0;
+
+	if ((sort != SORT_PSS) && (sort != SORT_USS))
+		return (0);
+	serial++;
+	start = mono_time();
+
+	for (i=0; i<nprocs; i++)
+		if ((n = proc_lookup( pids[i])) != -1) {
+			read_pss( procs + n);
+			procs[n].pss_serial = serial;
+		}
+
+	for (n=0; (n < procs_maxi) && (mono_time() - start < PSS_BUDGET); n++) {
+		if (cursor >= procs_maxi)
+			cursor = 0;
+		p = procs + cursor++;
+		if (!p->pid || p->filtered || p->pss_denied || 
+				(p->pss_serial == serial))
 			continue;
-		for (i=0; fstypes[i]; i++)
-			if (!strcmp( fstypes[i], type))
-				break;
-		if (!fstypes[i])
+		read_pss( p);
+		p->pss_serial = serial;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_sched: Read /proc/<pid>/schedstat of process `p' and update its run
+ * queue wait: the time its threads were runnable but waited for a CPU, and
+ * its CPU time, both in nanoseconds since the last read.
+ * Without CONFIG_SCHED_INFO, the file does not exist and no process is
+ * tried again. */
+
+int read_sched( struct process_info * p)
+{
+	char fname[FILENAME_MAX], buf[128];
+	unsigned long long run, wait;
+	double now, dt;
+	int fd, n;
+
+	sprintf( fname, "%s/%d/schedstat", procroot, p->pid);
+	if ((fd = open( fname, O_RDONLY)) == -1) {
+		p->sched_missing = (errno == ENOENT);
+		return (1);
+	}
+	n = read( fd, buf, sizeof (buf) - 1);
+	close( fd);
+	if (n <= 0)
+		return (1);
+	buf[n] = '\000';
+	if (sscanf( buf, "%llu %llu", &run, &wait) != 2)
+		return (1);
+
+	now = mono_time();
+	dt = now - p->sched_t;
+	if (p->sched_t && (dt > 0)) {
+		p->sched_rate = (wait >= p->sched_wait) ? 
+				(wait - p->sched_wait) / (dt * 1e6) : 0;
+		p->sched_cpu = (run >= p->sched_run) ? 
+				(run - p->sched_run) / (dt * 1e9) : 0;
+	}
+	p->sched_run = run;
+	p->sched_wait = wait;
+	p->sched_t = now;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_procsched: Update the run queue wait of the processes, when sorting
+ * on it. Like read_procio(), this spends at most SCHED_BUDGET seconds per
+ * update: on the processes that are shown first, then on the others in
+ * turn. */
+
+int read_procsched( void)
+{
+	int i, n;
+	double start;
+	struct process_info * p;
+
+	static int cursor = 0, serial = 0;
+
+	if (sort != SORT_RUNQ)
+		return (0);
+	serial++;
+	start = mono_time();
+
+	for (i=0; i<nprocs; i++)
+		if ((n = proc_lookup( pids[i])) != -1) {
+			read_sched( procs + n);
+			procs[n].sched_serial = serial;
+		}
+
+	for (n=0; (n < procs_maxi) && (mono_time() - start < SCHED_BUDGET); 
+			n++) {
+		if (cursor >= procs_maxi)
+			cursor = 0;
+		p = procs + cursor++;
+		if (!p->pid || p->filtered || p->sched_missing || 
+				(p->sched_serial == serial))
 			continue;
-		if (!strncmp( rw, "ro", 2))
+		read_sched( p);
+		p->sched_serial = serial;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_schedstat: Read the run queue wait of every CPU from
+ * /proc/schedstat, the eighth number on its line. The sum shows when
+ * tasks wait for a CPU, which the load average does not tell apart from
+ * tasks that wait for I/O. */
+
+int read_schedstat( void)
+{
+	char fname[FILENAME_MAX], * p, * q;
+	unsigned long long delay;
+	double now, dt, rate;
+	int n;
+
+	sprintf( fname, "%s/schedstat", procroot);
+	if (readfile( fname, &schedstat_fd, &schedstat_buf, &schedstat_size)
+			== -1) {
+		cpu.runq_ok = 0;
+		return (1);
+	}
+	now = mono_time();
+	dt = now - runq_t;
+	cpu.runq_wait = cpu.runq_max = 0;
+	for (p=schedstat_buf; *p; p=q) {
+		if (!(q = strchr( p, '\n')))
+			q = p + strlen( p);
+		else
+			q++;
+		if (sscanf( p, "cpu%d %*u %*u %*u %*u %*u %*u %*u %llu", &n, 
+				&delay) != 2)
 			continue;
-		statfs( mntpoint, &f);
-		if (f.f_bavail < (min_diskfree/f.f_bsize)) {
-			queue_msg( MED_PRIO, "%.18s is FULL!!", mntpoint);
-			full = 1;
+		if (n >= runq_ncpus) {
+			runq_old = xrealloc( runq_old, (n+1) * 
+					sizeof (unsigned long long));
+			while (runq_ncpus <= n)
+				runq_old[runq_ncpus++] = delay;
 		}
+		rate = (runq_t && (dt > 0) && (delay >= runq_old[n])) ?
+				(delay - runq_old[n]) / (dt * 1e6) : 0;
+		runq_old[n] = delay;
+		cpu.runq_wait += rate;
+		if (rate > cpu.runq_max)
+			cpu.runq_max = rate;
 	}
-	fclose( statfile);
-	if (!full) 
-		queue_msg( MIN_PRIO, "No filesystems are full");
-
+	cpu.runq_ok = (runq_ncpus > 0);
+	runq_t = now;
 	return (0);
 }
 
@@ -315,16 +698,18 @@ int check_diskfree( void)
 
 int read_cpu( void)
 {
+	char fname[FILENAME_MAX], line[BUFSIZ];
 	FILE * statfile;
 	unsigned int user, nice, system, idle, i;
 
-	if (!(statfile = fopen( "/proc/stat", "r"))) {
-		queue_msg( MAX_PRIO, "/proc/stat: %s", strerror( errno));
+	sprintf( fname, "%s/stat", procroot);
+	if (!(statfile = fopen( fname, "r"))) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
 		return (1);
 	}
 	if (fscanf( statfile, "cpu %u %u %u %u", &user, &nice, &system, 
 			&idle) != 4) {
-		queue_msg( MAX_PRIO, "/proc/stat: ? format");
+		queue_msg( MAX_PRIO, "%s: ? format", fname);
 		fclose( statfile);
 		return (1);
 	}
@@ -355,6 +740,15 @@ int read_cpu( void)
 			     cpu.system[(i-2) & 7] * WEIGHT_3;
 	cpu.systemjiffies = system;
 
+	/* The pressure page also shows context switches and forks */
+
+	while ((page == PAGE_PSI) && fgets( line, BUFSIZ, statfile)) {
+		if (!strncmp( line, "ctxt ", 5))
+			vmstats.v[VM_CTXT] = strtoull( line+5, NULL, 10);
+		else if (!strncmp( line, "processes ", 10))
+			vmstats.v[VM_FORKS] = strtoull( line+10, NULL, 10);
+	}
+
 	fclose( statfile);
 	return (0);
 }
@@ -364,9 +758,8 @@ int read_cpu( void)
 
 int read_mem( void)
 {
-	char buf[BUFSIZ];
+	char buf[BUFSIZ], fname[FILENAME_MAX];
 	FILE * statfile;
-	char fmt[32];
 	int i, format;
 	struct {
 		char * str;
@@ -382,8 +775,9 @@ int read_mem( void)
 		{ NULL, NULL}
 	};
 
-	if (!(statfile = fopen( "/proc/meminfo", "r"))) {
-		queue_msg( MAX_PRIO, "/proc/meminfo: %s", strerror( errno));
+	sprintf( fname, "%s/meminfo", procroot);
+	if (!(statfile = fopen( fname, "r"))) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
 		return (1);
 	}
 
@@ -403,33 +797,43 @@ int read_mem( void)
 		fgets( buf, BUFSIZ, statfile);
 		if (sscanf( buf, "Mem: %lu %lu %lu %lu %lu %lu", &mem.total, &mem.used, 
 				&mem.free, &mem.shared, &mem.buffers, &mem.cached) != 6) {
-			queue_msg( MAX_PRIO, "/proc/meminfo: ? format");
+			queue_msg( MAX_PRIO, "%s: ? format", fname);
 			fclose( statfile);
 			return (1);
 		}
 		fgets( buf, BUFSIZ, statfile);
 		if (sscanf( buf, "Swap: %lu %lu %lu", &mem.swaptotal, &mem.swapused, 
 				&mem.swapfree) != 3) {
-			queue_msg( MAX_PRIO, "/proc/meminfo: ? format");
+			queue_msg( MAX_PRIO, "%s: ? format", fname);
 			fclose( statfile);
 			return (1);
 		}
-		fclose( statfile);
 	} else {
-		for (i=0; lines[i].str; i++) {
-			sprintf( fmt, "%s: %%d", lines[i].str);	/* Make format string	*/
-			fgets( buf, BUFSIZ, statfile);
-			if (!sscanf( buf, fmt, lines[i].i)) {
-				queue_msg( MAX_PRIO, "/proc/meminfo: ? format");
-				fclose( statfile);
-				return (1);
-			}
-			*lines[i].i <<= 10;						/* Convert to bytes		*/
+
+		/* Newer kernels add and remove lines all the time, so we look
+		 * the lines up by their key. */
+
+		for (i=0; lines[i].str; i++)
+			*lines[i].i = 0;
+		while (fgets( buf, BUFSIZ, statfile)) {
+			for (i=0; lines[i].str; i++)
+				if (!strncmp( buf, lines[i].str, strlen( lines[i].str)) &&
+						(buf[strlen( lines[i].str)] == ':')) {
+					*lines[i].i = strtoul( buf + strlen( lines[i].str) + 1,
+							NULL, 10) << 10;		/* Convert to bytes		*/
+					break;
+				}
+		}
+		if (!mem.total) {
+			queue_msg( MAX_PRIO, "%s: ? format", fname);
+			fclose( statfile);
+			return (1);
 		}
 		
 		mem.used = mem.total - mem.free;
 		mem.swapused = mem.swaptotal - mem.swapfree;
 	}
+	fclose( statfile);
 		
 	return (0);
 }
@@ -447,14 +851,12 @@ void proc_update( int sig)
 		skip--;
 		return;
 	}
-	update_jiffies();
+	prof_begin( STAGE_JIFFIES); update_jiffies(); prof_end( STAGE_JIFFIES);
 
-	read_procs();
-	read_cpu();
-	read_loads();
-	read_mem();
-	read_logins();
-	check_diskfree();
+	source_update();
+	prof_tick( profile);
+	if (budget > 0)
+		adapt_period();
 
 	/* We must check if the update takes more time than the update period.
 	 * If this is the case, the main program loop does not run because
@@ -570,10 +972,18 @@ int load_wchans( void)
 
 int proc_init( void)
 {
-	if (access( "/proc/version", R_OK)) {
-		fprintf( stderr, "Proc filesystem is not mounted on /proc\n");
+	char fname[FILENAME_MAX];
+	int i;
+
+	sprintf( fname, "%s/version", procroot);
+	if (access( fname, R_OK)) {
+		fprintf( stderr, "Proc filesystem is not mounted on %s\n", procroot);
 		return (1);
 	}
+	for (i=0; i<PID_HASH_SIZE; i++)
+		pidhash[i] = -1;
+	if ((clk_tck = sysconf( _SC_CLK_TCK)) <= 0)
+		clk_tck = HZ;
 
 	logins = xmalloc( logins_size * sizeof (struct utmp));
 	procs = xmalloc( procs_size * sizeof (struct process_info));
@@ -581,8 +991,32 @@ int proc_init( void)
 
 	if (load_wchans())
 		warned = 1;
+	if (cgroup_init())
+		return (1);
+	if (fs_init())
+		return (1);
+	if (disk_init())
+		return (1);
+	if (net_init())
+		return (1);
+	if (sock_init())
+		return (1);
+	if (psi_init())
+		return (1);
+	if (kmsg_init())
+		return (1);
+	if (hist_init())
+		return (1);
+	if (window_init())
+		return (1);
+	if (aggr_init())
+		return (1);
+	if (thread_init())
+		return (1);
+	if (watch_init())
+		return (1);
 	
-	utmpname( _PATH_UTMP);
+	utmpname( utmpfile);
 
 	return (0);
 }
@@ -0,0 +1,235 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * prof.c: Timing of the stages of a data update and of the screen update.
+ * The time a stage takes during one update is put in a histogram with
+ * logarithmic buckets that are split linearly, like HDR histograms. This
+ * takes a fixed amount of memory and gives percentiles with a relative
+ * error below 1/16.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct stage_info stages[NSTAGES] = {
+	{ "update_jiffies", "jiffies" },
+	{ "read_procs", "procs" },
+	{ "readdir", " readdir" },
+	{ "stat", " stat" },
+	{ "status", " status" },
+	{ "cmdline", " cmdline" },
+	{ "getpwuid", " getpwuid" },
+	{ "read_sched", " sched" },
+	{ "cgroup_member", " cgroup" },
+	{ "read_procio", "procio" },
+	{ "read_procpss", "procpss" },
+	{ "read_procsched", "procsch" },
+	{ "cgroup_update", "cgroups" },
+	{ "read_cpu", "cpu" },
+	{ "read_schedstat", "schedstat" },
+	{ "read_loads", "loads" },
+	{ "read_mem", "mem" },
+	{ "read_logins", "logins" },
+	{ "check_diskfree", "diskfree" },
+	{ "read_disks", "disks" },
+	{ "read_net", "net" },
+	{ "read_sockets", "sockets" },
+	{ "read_psi", "psi" },
+	{ "hist_update", "history" },
+	{ "sort", "sort" },
+	{ "render", "render" }
+};
+
+double		self_cpu		= 0;	/* Our own CPU usage in % */
+long		self_rwcalls	= 0;	/* Our read/write calls per update */
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			lat_index			(unsigned long);
+unsigned long	lat_value		(int);
+
+/* ------------------------------------------------------------------------
+ * lat_index: Return the histogram bucket for `v' microseconds. Values
+ * below LAT_SUB have a bucket each. Above that, every power of two is
+ * split in LAT_SUB/2 buckets. */
+
+int lat_index( unsigned long v)
+{
+	int e;
+
+	if (v < LAT_SUB)
+		return (v);
+	for (e=0; v >> (e+1); e++);		/* e is the highest bit set */
+	if (e > LAT_MAXBIT)
+		return (LAT_BUCKETS-1);
+	return (LAT_SUB + (e - LAT_SUBBITS) * (LAT_SUB/2) +
+			((v >> (e - LAT_SUBBITS + 1)) & (LAT_SUB/2 - 1)));
+}
+
+/* ------------------------------------------------------------------------
+ * lat_value: Return the middle of histogram bucket `i'. */
+
+unsigned long lat_value( int i)
+{
+	int e, m;
+
+	if (i < LAT_SUB)
+		return (i);
+	e = (i - LAT_SUB) / (LAT_SUB/2) + LAT_SUBBITS;
+	m = (i - LAT_SUB) % (LAT_SUB/2) + LAT_SUB/2;
+	return (((unsigned long) m << (e - LAT_SUBBITS + 1)) +
+			((1UL << (e - LAT_SUBBITS + 1)) >> 1));
+}
+
+/* ------------------------------------------------------------------------
+ * prof_percentile: Return the `pct' percentile of stage `s', in
+ * microseconds. */
+
+unsigned long prof_percentile( int s, double pct)
+{
+	unsigned long n, want;
+	int i;
+
+	if (!stages[s].n)
+		return (0);
+	want = ceil( stages[s].n * pct / 100);
+	for (i=n=0; i<LAT_BUCKETS; i++)
+		if ((n += stages[s].lat[i]) >= want)
+			break;
+	if (i == LAT_BUCKETS)
+		i--;
+	return (lat_value( i) > stages[s].max ? stages[s].max : lat_value( i));
+}
+
+/* ------------------------------------------------------------------------
+ * prof_begin: Mark the start of stage `s'. */
+
+void prof_begin( int s)
+{
+	stages[s].start = mono_time();
+}
+
+/* ------------------------------------------------------------------------
+ * prof_end: Mark the end of stage `s'. */
+
+void prof_end( int s)
+{
+	stages[s].tick += mono_time() - stages[s].start;
+	stages[s].ran = 1;
+}
+
+/* ------------------------------------------------------------------------
+ * prof_lap: Account the time since `t' to stage `s' and return the current
+ * time. This is used for the sub stages of read_procs(), which alternate
+ * for every process. */
+
+double prof_lap( int s, double t)
+{
+	double now;
+
+	now = mono_time();
+	stages[s].tick += now - t;
+	stages[s].ran = 1;
+	return (now);
+}
+
+/* ------------------------------------------------------------------------
+ * read_rwcalls: Return the number of read and write system calls we did,
+ * from /proc/self/io. Other system calls, like open() and close(), are
+ * not counted there. This is about hifs itself, so it does not use the
+ * proc root. */
+
+long read_rwcalls( void)
+{
+	char buf[BUFSIZ], * p;
+	long syscr, syscw;
+	int fd, n;
+
+	if ((fd = open( "/proc/self/io", O_RDONLY)) == -1)
+		return (0);
+	n = read( fd, buf, BUFSIZ-1);
+	close( fd);
+	if (n <= 0)
+		return (0);
+	buf[n] = '\000';
+	syscr = (p = strstr( buf, "syscr:")) ? atol( p+6) : 0;
+	syscw = (p = strstr( buf, "syscw:")) ? atol( p+6) : 0;
+	return (syscr + syscw);
+}
+
+/* ------------------------------------------------------------------------
+ * self_time: Return the CPU time we used so far, in seconds. */
+
+double self_time( void)
+{
+	struct rusage ru;
+
+	getrusage( RUSAGE_SELF, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+			ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+}
+
+/* ------------------------------------------------------------------------
+ * prof_tick: Put the time each stage took since the last call in its
+ * histogram. Also measure our own CPU usage and, if `count_rwcalls' is
+ * nonzero, our read and write system calls. Called at the end of every update. */
+
+void prof_tick( int count_rwcalls)
+{
+	int i;
+	unsigned long us;
+	double now, cpu;
+	long sc;
+	struct stage_info * st;
+
+	static double last_now = 0, last_cpu = 0;
+	static long last_sc = 0;
+
+	for (i=0; i<NSTAGES; i++) {
+		st = stages + i;
+		if (!st->ran)
+			continue;
+		us = st->tick * 1e6;
+		st->lat[lat_index( us)]++;
+		st->n++;
+		st->total += st->tick;
+		st->last = st->tick;
+		if (us > st->max)
+			st->max = us;
+		st->tick = 0;
+		st->ran = 0;
+	}
+
+	now = mono_time();
+	cpu = self_time();
+	if (last_now && (now > last_now))
+		self_cpu = (cpu - last_cpu) * 100 / (now - last_now);
+	last_now = now;
+	last_cpu = cpu;
+
+	if (count_rwcalls) {
+		sc = read_rwcalls();
+		self_rwcalls = last_sc ? sc - last_sc : 0;
+		last_sc = sc;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * prof_reset: Forget all timings. */
+
+void prof_reset( void)
+{
+	int i;
+
+	for (i=0; i<NSTAGES; i++) {
+		stages[i].n = stages[i].max = 0;
+		stages[i].total = stages[i].tick = stages[i].last = 0;
+		stages[i].ran = 0;
+		memset( stages[i].lat, 0, sizeof (stages[i].lat));
+	}
+}
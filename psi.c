@@ -0,0 +1,173 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * psi.c: Pressure stall information from /proc/pressure and paging rates
+ * from /proc/vmstat. A PSI trigger is set on every resource, so that a
+ * stall wakes hifs up at once instead of at the next update.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct psi_info psi[PSI_NRES] = {
+	{ "cpu", -1, -1, -1 },
+	{ "memory", -1, -1, -1 },
+	{ "io", -1, -1, -1 }
+};
+
+struct vm_stats		vmstats;				/* vmstat counters and rates */
+
+int					psi_bufsize		= 0;	/* size of psi_buf			*/
+int					vmstat_fd		= -1;	/* open /proc/vmstat		*/
+char *				psi_buf			= NULL;	/* contents of a file		*/
+
+/* The /proc/vmstat counters we use, and the VM_* field they add to */
+
+struct vm_name {
+	char *			name;
+	int				field;
+} vm_names[] = {
+	{ "pgmajfault", VM_MAJFLT },
+	{ "pswpin", VM_PSWPIN },
+	{ "pswpout", VM_PSWPOUT },
+	{ "pgscan_kswapd", VM_PGSCAN },
+	{ "pgscan_direct", VM_PGSCAN },
+	{ "pgscan_khugepaged", VM_PGSCAN },
+	{ "pgsteal_kswapd", VM_PGSTEAL },
+	{ "pgsteal_direct", VM_PGSTEAL },
+	{ "pgsteal_khugepaged", VM_PGSTEAL },
+	{ "oom_kill", VM_OOM },
+	{ NULL, 0 }
+};
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			read_pressure		(struct psi_info *);
+int			read_vmstat			(void);
+
+/* ------------------------------------------------------------------------
+ * read_pressure: Read the 10 second averages of resource `p'. */
+
+int read_pressure( struct psi_info * p)
+{
+	char fname[FILENAME_MAX], * s;
+
+	sprintf( fname, "%s/pressure/%s", procroot, p->name);
+	if (readfile( fname, &p->fd, &psi_buf, &psi_bufsize) == -1) {
+		p->ok = 0;
+		return (1);
+	}
+	p->some = (s = strstr( psi_buf, "some avg10=")) ? atof( s+11) : 0;
+	p->full = (s = strstr( psi_buf, "full avg10=")) ? atof( s+11) : 0;
+	p->ok = 1;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_vmstat: Read the counters in vm_names from /proc/vmstat. */
+
+int read_vmstat( void)
+{
+	char fname[FILENAME_MAX];
+	char * p, * q;
+	int i, len;
+
+	sprintf( fname, "%s/vmstat", procroot);
+	if (readfile( fname, &vmstat_fd, &psi_buf, &psi_bufsize) == -1) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+		return (1);
+	}
+	for (i=0; i<VM_STAT_FIELDS; i++)
+		vmstats.v[i] = 0;
+
+	for (p=psi_buf; *p; p=q) {
+		if (!(q = strchr( p, '\n')))
+			q = p + strlen( p);
+		else
+			q++;
+		len = strcspn( p, " ");
+		for (i=0; vm_names[i].name; i++)
+			if (!strncmp( vm_names[i].name, p, len) &&
+					!vm_names[i].name[len]) {
+				vmstats.v[vm_names[i].field] += strtoull( p+len, NULL, 10);
+				break;
+			}
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_psi: Update the pressure averages and the vmstat rates. Only done
+ * while the pressure page is shown. The ctxt and processes counters are
+ * read from /proc/stat by read_cpu(). */
+
+int read_psi( void)
+{
+	double now, dt;
+	int i;
+
+	if (page != PAGE_PSI)
+		return (0);
+	for (i=0; i<PSI_NRES; i++)
+		read_pressure( psi + i);
+	read_vmstat();
+
+	now = mono_time();
+	dt = now - vmstats.t;
+	if (vmstats.t && (dt > 0))
+		for (i=0; i<VM_NFIELDS; i++)
+			vmstats.rate[i] = (vmstats.v[i] >= vmstats.old[i]) ?
+					(vmstats.v[i] - vmstats.old[i]) / dt : 0;
+	memcpy( vmstats.old, vmstats.v, sizeof (vmstats.v));
+	vmstats.t = now;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * psi_wake: Called when xgetch() was woken by a wake descriptor. Tells
+ * the user about the resources whose trigger fired, and returns nonzero
+ * if there were any. */
+
+int psi_wake( void)
+{
+	int i, n;
+
+	for (i=n=0; i<PSI_NRES; i++)
+		if ((psi[i].wake != -1) && wake_ready( psi[i].wake)) {
+			queue_msg( MED_PRIO, "%s stall", psi[i].name);
+			n++;
+		}
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * psi_init: Set a trigger on every resource and register it with
+ * xgetch(). The kernel raises POLLPRI on the trigger when the tasks were
+ * stalled for PSI_THRESHOLD of PSI_WINDOW microseconds. Without PSI, or
+ * without the permission to set triggers, there are none. */
+
+int psi_init( void)
+{
+	char fname[FILENAME_MAX], trig[64];
+	int i, fd;
+
+	memset( &vmstats, 0, sizeof (vmstats));
+	sprintf( trig, "some %d %d", PSI_THRESHOLD, PSI_WINDOW);
+	for (i=0; i<PSI_NRES; i++) {
+		sprintf( fname, "%s/pressure/%s", procroot, psi[i].name);
+		if ((fd = open( fname, O_RDWR | O_NONBLOCK)) == -1)
+			continue;
+		if (write( fd, trig, strlen( trig) + 1) == -1) {
+			close( fd);
+			continue;
+		}
+		psi[i].trig_fd = fd;
+		psi[i].wake = wake_add( fd, POLLPRI);
+	}
+	return (0);
+}
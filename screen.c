@@ -14,6 +14,12 @@ char	Hostname[MAX_HOSTNAME+1];		/* Niced hostname */
 
 int 	nprocs;					/* # of processes to show			*/
 int		pids[32];				/* Pids of processes to show		*/
+int		top_mark		= 0;	/* Marks the processes shown		*/
+
+int		nwake			= 0;	/* # of wake descriptors			*/
+int		wake_fds[MAX_WAKE];		/* Wake descriptors for xgetch()	*/
+short	wake_events[MAX_WAKE];	/* POLLIN or POLLPRI for each		*/
+int		wake_flags[MAX_WAKE];	/* Which of them fired				*/
 
 int 	nmessages		= 0;	/* # of messages in message queue 	*/
 int		messages_size	= 32;	/* initial message table size		*/
@@ -30,6 +36,25 @@ void		show_logins			(void);
 void		show_groups			(void);
 void		show_messages		(void);
 void		show_flags			(void);
+void		show_cgroups		(void);
+void		show_aggr			(int);
+void		show_tree			(void);
+void		show_threads		(void);
+void		show_profile		(void);
+void		show_mounts			(void);
+void		show_disks			(void);
+void		show_net			(void);
+void		show_sockets		(void);
+void		show_psi			(void);
+void		show_events			(void);
+void		show_history		(void);
+void		sparkline			(char *, double *, int, double);
+char *		fmt_eta				(char *, double);
+char *		fmt_size			(char *, double);
+char *		fmt_short			(char *, double);
+char *		fmt_count			(char *, double);
+char *		fmt_age				(char *, double);
+char *		fmt_time			(char *, unsigned long);
 int			logged_in			(const char *);
 void		sort_procs			(void);
 
@@ -43,9 +68,9 @@ void		title				(const char * fmt, ...);
 
 void sort_procs( void) 
 {
-	int i, j, k, l;
+	int i, j, k, l, g;
 	unsigned long umin;
-	double dmin;
+	double dmin, v;
 
 	/* We get the top MAX_SHOWPROCESSES of the processes using a kind of
 	 * selectionsort. This algorithm should be fast when a) the array to
@@ -54,12 +79,20 @@ void sort_procs( void)
 	 * The array is not touched, the first MAX_SHOWPROCESSES pids
 	 * are stored into the array 'pids'. */
 
-	/* Find the 0..MAX_SHOWPROCESSES highest maximums */
+	/* Find the 0..MAX_SHOWPROCESSES highest maximums. The processes are
+	 * marked, so that the next update reads them more precisely. The
+	 * watched processes come first, whatever their rank. */
 
-	for (i=0; i<MAX_SHOWPROCESSES; i++) {
+	top_mark++;
+	for (i=g=0; g<nwatched; g++)
+		if (!procs[watched[g]].filtered) {
+			pids[i++] = procs[watched[g]].pid;
+			procs[watched[g]].top = top_mark;
+		}
+	for (; i<MAX_SHOWPROCESSES; i++) {
 		dmin = umin = k = 0;
 		for (j=0; j<procs_maxi; j++) {
-			if (!procs[j].pid)
+			if (!procs[j].pid || procs[j].filtered)
 				continue;
 			switch (sort) {
 			case SORT_CPU:
@@ -89,9 +122,116 @@ void sort_procs( void)
 					k = j;
 				}
 				break;
+			case SORT_IO_READ:
+				if (procs[j].io_rrate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].io_rrate;
+					k = j;
+				}
+				break;
+			case SORT_IO_WRITE:
+				if (procs[j].io_wrate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].io_wrate;
+					k = j;
+				}
+				break;
+			case SORT_PSS:
+				if (procs[j].pss > umin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					umin = procs[j].pss;
+					k = j;
+				}
+				break;
+			case SORT_USS:
+				if (procs[j].uss > umin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					umin = procs[j].uss;
+					k = j;
+				}
+				break;
+			case SORT_CPU_1M: case SORT_CPU_5M: case SORT_CPU_15M:
+				if ((v = window_pct( procs+j, sort - SORT_CPU_1M)) > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = v;
+					k = j;
+				}
+				break;
+			case SORT_RUNQ:
+				if (procs[j].sched_rate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].sched_rate;
+					k = j;
+				}
+				break;
+			case SORT_BLKIO:
+				if (procs[j].blkio_rate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].blkio_rate;
+					k = j;
+				}
+				break;
+			case SORT_MAJFLT:
+				if (procs[j].majflt_rate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].majflt_rate;
+					k = j;
+				}
+				break;
+			case SORT_MINFLT:
+				if (procs[j].minflt_rate > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = procs[j].minflt_rate;
+					k = j;
+				}
+				break;
+			case SORT_CSW:
+				if ((v = procs[j].vcsw_rate + procs[j].ivcsw_rate) > dmin) {
+					for (l=0; (l < i) && (procs[j].pid != pids[l]); l++);
+					if (l != i)
+						break;
+					dmin = v;
+					k = j;
+				}
+				break;
 			}
 		}
-		pids[i] = procs[k].pid;
+
+		/* In the window modes, the processes that exited count too. They
+		 * are stored as -1 minus their index in the ghost table. */
+
+		for (j=g=0; (sort >= SORT_CPU_1M) && (sort <= SORT_CPU_15M) &&
+				(j < nghosts); j++) {
+			if (ghosts[j].filtered || ((v = window_pct( ghosts+j, 
+					sort - SORT_CPU_1M)) <= dmin))
+				continue;
+			for (l=0; (l < i) && (pids[l] != -1 - j); l++);
+			if (l != i)
+				continue;
+			dmin = v;
+			g = -1 - j;
+		}
+		pids[i] = g ? g : procs[k].pid;
+		if (!g)
+			procs[k].top = top_mark;
 
 		if (!dmin && !umin)
 			break;
@@ -122,39 +262,95 @@ void show_procs( void)
 {
 	int i, j;
 	char buf[32];
+	struct process_info * p;
 
 	for (i=0; pids[i]; i++) {
 
-		for (j=0; (j < procs_maxi) && (procs[j].pid != pids[i]); j++);
-		if (j == procs_maxi)
-			continue;
+		if (pids[i] < 0)
+			p = ghosts - 1 - pids[i];
+		else {
+			for (j=0; (j < procs_maxi) && (procs[j].pid != pids[i]); j++);
+			if (j == procs_maxi)
+				continue;
+			p = procs + j;
+		}
+
+		/* Processes with many major faults are highlighted */
+
+		if (majflt_warn && (p->majflt_rate >= majflt_warn))
+			attrset( A_BOLD);
 
-		/* column 1: process name */
+		/* column 1: process name, marked if it is watched */
 
-		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", procs[j].comm);
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s%c", p->comm, 
+				((pids[i] > 0) && (p->watched > 0)) ? '*' : ' ');
 
 		/* column 2: process info, sorted on */
 
 		switch (sort) {
 		case SORT_CPU:
 			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.1f%% %c ", 
-					procs[j].pct_cpu, procs[j].state);
+					((pids[i] > 0) && (p->watched > 0) && p->watch_t) ?
+					p->watch_cpu : p->pct_cpu, p->state);
 			break;
 		case SORT_RSS:
-			if (procs[j].rss >> 20) 
-				sprintf( buf, "%4.1fM", (double) procs[j].rss / (1024*1024));
+			if (p->rss >> 20) 
+				sprintf( buf, "%4.1fM", (double) p->rss / (1024*1024));
 			else
-				sprintf( buf, "%4luK", procs[j].rss >> 10);
+				sprintf( buf, "%4luK", p->rss >> 10);
 			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s %c ", buf, 
-					procs[j].state);
+					p->state);
 			break;
 		case SORT_VSIZE:
-			if (procs[j].vsize >> 20) 
-				sprintf( buf, "%4.1fM", (double) procs[j].vsize / (1024*1024));
+			if (p->vsize >> 20) 
+				sprintf( buf, "%4.1fM", (double) p->vsize / (1024*1024));
 			else
-				sprintf( buf, "%4luK", procs[j].vsize >> 10);
+				sprintf( buf, "%4luK", p->vsize >> 10);
 			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s %c ", buf, 
-					procs[j].state);
+					p->state);
+			break;
+		case SORT_IO_READ:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/s ", 
+					fmt_size( buf, p->io_rrate));
+			break;
+		case SORT_IO_WRITE:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/s ", 
+					fmt_size( buf, p->io_wrate));
+			break;
+		case SORT_CPU_1M: case SORT_CPU_5M: case SORT_CPU_15M:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.1f%% %c ", 
+					window_pct( p, sort - SORT_CPU_1M), p->state);
+			break;
+		case SORT_RUNQ:
+			if (p->sched_missing)
+				mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "    - %c ", 
+						p->state);
+			else
+				mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.0fm %c ", 
+						p->sched_rate, p->state);
+			break;
+		case SORT_BLKIO:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.0fm %c ", 
+					p->blkio_rate, p->state);
+			break;
+		case SORT_MAJFLT:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, " %s %c ", 
+					fmt_count( buf, p->majflt_rate), p->state);
+			break;
+		case SORT_MINFLT:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, " %s %c ", 
+					fmt_count( buf, p->minflt_rate), p->state);
+			break;
+		case SORT_CSW:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, " %s %c ", 
+					fmt_count( buf, p->vcsw_rate + p->ivcsw_rate), 
+					p->state);
+			break;
+		case SORT_PSS: case SORT_USS:
+			fmt_short( buf, sort == SORT_PSS ? p->pss : p->uss);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s %s ", buf, 
+					fmt_age( buf + 8, p->pss_t ? 
+					mono_time() - p->pss_t : -1));
 			break;
 		}
 
@@ -162,23 +358,43 @@ void show_procs( void)
 
 		switch (info) {
 		case INFO_PID:
-			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9d", procs[j].pid);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9d", p->pid);
 			break;
 		case INFO_CMDLINE:
-			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9.9s", procs[j].cmdline);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9.9s", p->cmdline);
 			break;
 		case INFO_WCHAN:
 			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9.9s", 
-					procs[j].strwchan);
+					p->strwchan);
 			break;
 		case INFO_NAME:
-			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9.9s", procs[j].user);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9.9s", p->user);
 			break;
 		case INFO_PRIO:
-			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9d", procs[j].priority);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9d", p->priority);
+			break;
+		case INFO_IO:
+			if (p->io_denied) {
+				mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%-9s", "-");
+				break;
+			}
+			fmt_short( buf, p->io_rrate);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%4s/%-4s", buf, 
+					fmt_short( buf + 8, p->io_wrate));
+			break;
+		case INFO_FAULTS:
+			fmt_count( buf, p->majflt_rate);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%4s/%-4s", buf, 
+					fmt_count( buf + 8, p->minflt_rate));
+			break;
+		case INFO_CSW:
+			fmt_count( buf, p->vcsw_rate);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%4s/%-4s", buf, 
+					fmt_count( buf + 8, p->ivcsw_rate));
 			break;
 			
 		}
+		attrset( 0);
 	
 	}
 
@@ -186,6 +402,675 @@ void show_procs( void)
 		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY); 
 }
 
+/* ------------------------------------------------------------------------
+ * fmt_size: Format a size in bytes in five characters. */
+
+char * fmt_size( char * buf, double size)
+{
+	if (size >= 1024.0 * 1024 * 1024)
+		sprintf( buf, "%4.1fG", size / (1024.0 * 1024 * 1024));
+	else if (size >= 1024.0 * 1024)
+		sprintf( buf, "%4.1fM", size / (1024.0 * 1024));
+	else
+		sprintf( buf, "%4luK", (unsigned long) size >> 10);
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * fmt_short: Format a size in bytes in four characters. */
+
+char * fmt_short( char * buf, double size)
+{
+	char * unit = "KMGT";
+
+	size /= 1024;
+	while ((size >= 999.5) && unit[1]) {
+		size /= 1024;
+		unit++;
+	}
+	if (size < 9.95)
+		sprintf( buf, "%3.1f%c", size, *unit);
+	else
+		sprintf( buf, "%3.0f%c", size, *unit);
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * fmt_count: Format a count, or a rate, in four characters. */
+
+char * fmt_count( char * buf, double count)
+{
+	if (count < 9999.5)
+		sprintf( buf, "%4.0f", count);
+	else if (count < 999.5e3)
+		sprintf( buf, "%3.0fK", count / 1e3);
+	else
+		sprintf( buf, "%3.0fM", count / 1e6);
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * fmt_age: Format an age in seconds in two characters, or a `-' if it is
+ * negative. Minutes and hours are rounded up. */
+
+char * fmt_age( char * buf, double age)
+{
+	if (age < 0)
+		strcpy( buf, " -");
+	else if (age < 9.5)
+		sprintf( buf, "%.0fs", age);
+	else if (age <= 9 * 60)
+		sprintf( buf, "%.0fm", ceil( age / 60));
+	else if (age <= 9 * 3600)
+		sprintf( buf, "%.0fh", ceil( age / 3600));
+	else
+		strcpy( buf, "++");
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * show_cgroups: Show the top cgroups, in the same layout as the processes.
+ * The third column shows memory, or CPU when sorting on memory. */
+
+void show_cgroups( void)
+{
+	int i, n, top[MAX_SHOWPROCESSES];
+	char buf[32];
+	struct cgroup_info * cg;
+
+	if (!cgroup_ok) {
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No cgroup v2 found");
+		n = 1;
+	} else
+		n = cgroup_sort( top, MAX_SHOWPROCESSES);
+
+	for (i=0; cgroup_ok && (i<n); i++) {
+		cg = cgroups + top[i];
+
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", cg->name);
+
+		switch (cgsort) {
+		case CGSORT_CPU:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5.1f%%  ", cg->pct_cpu);
+			break;
+		case CGSORT_MEM:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s   ", 
+					fmt_size( buf, cg->memory));
+			break;
+		case CGSORT_IO:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/s ", 
+					fmt_size( buf, cg->rrate + cg->wrate));
+			break;
+		case CGSORT_PIDS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5dp  ", cg->pids);
+			break;
+		}
+
+		if (cgsort == CGSORT_MEM)
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%5.1f%%   ", 
+					cg->pct_cpu);
+		else
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%s    ", 
+					fmt_size( buf, cg->memory));
+	}
+
+	for (i=n; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY); 
+}
+
+/* ------------------------------------------------------------------------
+ * show_aggr: Show the top aggregates of `kind', in the same layout as the
+ * processes. The third column shows RSS and the number of processes, or
+ * CPU in place of the value that is sorted on. */
+
+void show_aggr( int kind)
+{
+	int i, n;
+	char buf[32];
+	struct aggr_info * a, * top[MAX_SHOWPROCESSES];
+
+	n = aggr_sort( kind, top, MAX_SHOWPROCESSES);
+	for (i=0; i<n; i++) {
+		a = top[i];
+
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", a->name);
+
+		switch (aggrsort) {
+		case AGGSORT_CPU:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5.1f%%  ", a->cpu);
+			break;
+		case AGGSORT_RSS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s   ", 
+					fmt_size( buf, a->rss));
+			break;
+		case AGGSORT_IO:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/s ", 
+					fmt_size( buf, a->io));
+			break;
+		case AGGSORT_PROCS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5dp  ", a->nprocs);
+			break;
+		}
+
+		switch (aggrsort) {
+		case AGGSORT_RSS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%3.0f%%%5d", 
+					a->cpu, a->nprocs);
+			break;
+		case AGGSORT_PROCS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%3.0f%%%s", 
+					a->cpu, fmt_short( buf, a->rss));
+			break;
+		default:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%s%5d", 
+					fmt_short( buf, a->rss), a->nprocs);
+			break;
+		}
+	}
+	if (!n) {
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", 
+				(kind == AGGR_GROUP) && !ngroups ? "No groups configured" :
+				"No processes");
+		n = 1;
+	}
+
+	for (i=n; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY); 
+}
+
+/* ------------------------------------------------------------------------
+ * show_tree: Show the process tree, with the CPU usage, RSS and number of
+ * processes of each subtree. Children are indented below their parent, and
+ * a `+' marks a collapsed process. The processes shown can be selected. */
+
+void show_tree( void)
+{
+	int i, n, d, top[MAX_SHOWPROCESSES], depth[MAX_SHOWPROCESSES];
+	char buf[PINFO_COMM_SIZE+8];
+	struct process_info * p;
+
+	n = tree_sort( top, depth, MAX_SHOWPROCESSES);
+	for (i=0; i<n; i++) {
+		p = procs + top[i];
+		pids[i] = p->pid;
+
+		d = (depth[i] < 4) ? depth[i] : 4;
+		sprintf( buf, "%.*s%s%s", d, "    ", p->collapsed ? "+" : "", 
+				p->comm);
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", buf);
+
+		if (treesort == TREESORT_RSS) {
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s   ", 
+					fmt_size( buf, p->sub_rss));
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%3.0f%%%5d", 
+					p->sub_cpu, p->sub_n);
+		} else {
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5.1f%%  ", 
+					p->sub_cpu);
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%s%5d", 
+					fmt_short( buf, p->sub_rss), p->sub_n);
+		}
+	}
+	nprocs = n;
+	if (!n) {
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No processes");
+		n = 1;
+	}
+
+	for (i=n; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY); 
+}
+
+/* ------------------------------------------------------------------------
+ * show_threads: Show the threads of the selected process, with their CPU
+ * usage or CPU time and state, and the CPU they last ran on and their
+ * wchan. The threads shown can be selected. */
+
+void show_threads( void)
+{
+	int i, n, top[MAX_SHOWPROCESSES];
+	char buf[32];
+	struct thread_info * t;
+
+	if (thread_pid && (thread_timer == -1))
+		thread_sample();
+	n = thread_pid ? thread_sort( top, MAX_SHOWPROCESSES) : 0;
+	for (i=0; i<n; i++) {
+		t = threads + top[i];
+		pids[i] = t->tid;
+
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", t->comm);
+		if (threadsort == THREADSORT_TIME)
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s %c  ", 
+					fmt_time( buf, t->run ? t->run / 1000 : 
+					t->jiffies * (1000000 / clk_tck)), t->state);
+		else
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.1f%% %c ", 
+					t->pct_cpu, t->state);
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%3d %-5.5s", t->cpu, 
+				t->wchan);
+	}
+	nprocs = n;
+	if (!n) {
+		if (!thread_pid)
+			mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", 
+					"No process selected");
+		else
+			mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-8.8s %-17s", 
+					thread_comm, "has exited");
+		n = 1;
+	}
+
+	for (i=n; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY); 
+}
+
+/* ------------------------------------------------------------------------
+ * fmt_eta: Format a time to full in seconds in five characters. Zero
+ * means never. */
+
+char * fmt_eta( char * buf, double secs)
+{
+	if (!secs)
+		strcpy( buf, "    -");
+	else if (secs < 100 * 60)
+		sprintf( buf, "%4dm", (int) (secs / 60) + 1);
+	else if (secs < 48 * 3600)
+		sprintf( buf, "%4.1fh", secs / 3600);
+	else if (secs < 10000 * 86400.0)
+		sprintf( buf, "%4dd", (int) (secs / 86400));
+	else
+		strcpy( buf, "    -");
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * show_mounts: Show the checked filesystems, in the same layout as the
+ * processes: the last part of the mount point, the sort key and the
+ * usage, or the time to full when sorting on usage. */
+
+void show_mounts( void)
+{
+	int i, n;
+	char buf[32], * name;
+	struct mount_info * top[MAX_SHOWPROCESSES], * m;
+
+	pthread_mutex_lock( &fs_lock);
+	n = fs_sort( top, MAX_SHOWPROCESSES);
+	for (i=0; i<n; i++) {
+		m = top[i];
+		name = strrchr( m->mntpoint, '/');
+		name = (name && name[1]) ? name+1 : m->mntpoint;
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", name);
+
+		switch (fssort) {
+		case FSSORT_GROWTH:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/h ",
+					fmt_size( buf, m->rate > 0 ? m->rate * 3600 : 0));
+			break;
+		case FSSORT_ETA:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s   ",
+					fmt_eta( buf, m->eta));
+			break;
+		case FSSORT_USE:
+		default:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5.1f%%  ", 
+					fs_used( m));
+			break;
+		}
+
+		if (fssort == FSSORT_USE)
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%s    ",
+					fmt_eta( buf, m->eta));
+		else
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%5.1f%%   ",
+					fs_used( m));
+	}
+	pthread_mutex_unlock( &fs_lock);
+
+	if (!n)
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No filesystems checked");
+	for (i=n ? n : 1; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * show_disks: Show the busiest block devices, in the same layout as the
+ * processes. The third column shows the throughput when sorting on
+ * utilisation, and the utilisation otherwise. */
+
+void show_disks( void)
+{
+	int i, n, top[MAX_SHOWPROCESSES];
+	char buf[32];
+	struct disk_info * d;
+
+	n = disk_sort( top, MAX_SHOWPROCESSES);
+	for (i=0; i<n; i++) {
+		d = disks + top[i];
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, "%-8.8s ", d->name);
+
+		switch (disksort) {
+		case DISKSORT_IOPS:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%6.0f  ",
+					d->riops + d->wiops);
+			break;
+		case DISKSORT_BYTES:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%s/s ",
+					fmt_size( buf, d->rbytes + d->wbytes));
+			break;
+		case DISKSORT_AWAIT:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%4.0fms  ",
+					d->await);
+			break;
+		case DISKSORT_QUEUE:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%6.2f  ", d->queue);
+			break;
+		case DISKSORT_UTIL:
+		default:
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_2, "%5.1f%%  ", d->util);
+			break;
+		}
+
+		if (disksort == DISKSORT_UTIL)
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%s/s  ",
+					fmt_size( buf, d->rbytes + d->wbytes));
+		else
+			mvprintw( Y_PROCESSES+i, X_PROCESSES_3, "%5.1f%%   ", d->util);
+	}
+
+	if (!n)
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No disks shown");
+	for (i=n ? n : 1; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * show_net: Show the TCP retransmits, resets and listen queue overflows
+ * per second, and below them the busiest interfaces, in the same layout as
+ * the processes. The third column of the TCP lines shows the retransmitted
+ * share of the sent segments, the established connections that were
+ * reset and the dropped connection requests. That of the interfaces shows
+ * the drops and errors, or the throughput when sorting on those. */
+
+void show_net( void)
+{
+	int i, n, y, top[MAX_SHOWPROCESSES];
+	char buf[32];
+	struct net_info * d;
+	struct tcp_stats * t = &tcpstats;
+
+	y = 0;
+	if (t->ok) {
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-9s%6.0f/s%5.1f%%   ",
+				"Retrans", t->rate[TCP_RETRANS], t->pct_retrans);
+		mvprintw( Y_PROCESSES+1, X_PROCESSES_1, "%-9s%6.0f/s%5.0f est ",
+				"Resets", t->rate[TCP_OUT_RSTS], 
+				t->rate[TCP_ESTAB_RESETS]);
+		mvprintw( Y_PROCESSES+2, X_PROCESSES_1, "%-9s%6.0f/s%5.0f drp ",
+				"ListenOv", t->rate[TCP_LISTEN_OVF], 
+				t->rate[TCP_LISTEN_DROPS]);
+		y = 3;
+	}
+
+	n = net_sort( top, MAX_SHOWPROCESSES - y);
+	for (i=0; i<n; i++, y++) {
+		d = nets + top[i];
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, "%-8.8s ", d->name);
+
+		switch (netsort) {
+		case NETSORT_PACKETS:
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_2, "%6.0f  ",
+					d->rpkts + d->tpkts);
+			break;
+		case NETSORT_DROPS:
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_2, "%6.0f  ",
+					d->drops + d->errs);
+			break;
+		case NETSORT_BYTES:
+		default:
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_2, "%s/s ",
+					fmt_size( buf, d->rbytes + d->tbytes));
+			break;
+		}
+
+		if (netsort == NETSORT_DROPS)
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_3, "%s/s  ",
+					fmt_size( buf, d->rbytes + d->tbytes));
+		else
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_3, "%5.0f drp ",
+					d->drops + d->errs);
+	}
+
+	if (!y)
+		mvprintw( Y_PROCESSES+y++, X_PROCESSES_1, "%-26s", 
+				"No interfaces shown");
+	for (; y<MAX_SHOWPROCESSES; y++)
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * show_sockets: Show the TCP sockets per group of states, the UDP and unix
+ * sockets, and below them the ports that are listened on with their
+ * accept queue and its maximum. */
+
+void show_sockets( void)
+{
+	int i, y;
+	struct sock_stats * s = &sockstats;
+
+	if (!s->ok) {
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No sock_diag");
+		for (y=1; y<MAX_SHOWPROCESSES; y++)
+			mvprintw( Y_PROCESSES+y, X_PROCESSES_1, EMPTY);
+		return;
+	}
+
+	mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-9s%7ld %6ld tw ", "tcp est",
+			s->tcp[TCP_ESTABLISHED], s->tcp[TCP_TIME_WAIT]);
+	mvprintw( Y_PROCESSES+1, X_PROCESSES_1, "%-9s%7ld %6ld cw ", "tcp syn",
+			s->tcp[TCP_SYN_SENT] + s->tcp[TCP_SYN_RECV] + 
+			s->tcp[SOCK_NEW_SYN_RECV], s->tcp[TCP_CLOSE_WAIT]);
+	mvprintw( Y_PROCESSES+2, X_PROCESSES_1, "%-9s%7ld %6ld lst", "tcp fin",
+			s->tcp[TCP_FIN_WAIT1] + s->tcp[TCP_FIN_WAIT2] + 
+			s->tcp[TCP_CLOSING] + s->tcp[TCP_LAST_ACK], s->tcp[TCP_LISTEN]);
+	mvprintw( Y_PROCESSES+3, X_PROCESSES_1, "%-9s%7ld %6ld unx", "udp",
+			s->udp, s->unx);
+
+	listen_sort();
+	for (i=0, y=4; (i < nlistens) && (y < MAX_SHOWPROCESSES); i++, y++)
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, ":%-8d%7lu /%-7lu", 
+				listens[i].port, listens[i].queue, listens[i].backlog);
+	for (; y<MAX_SHOWPROCESSES; y++)
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * show_psi: Show the share of time that some and all tasks were stalled
+ * on each resource, averaged over 10 seconds, and below it the paging,
+ * context switch and fork rates. */
+
+void show_psi( void)
+{
+	int i;
+	struct vm_stats * v = &vmstats;
+
+	attrset( A_BOLD);
+	mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-9s%6s  %6s   ", "Pressure", 
+			"some", "full");
+	attrset( 0);
+	for (i=0; i<PSI_NRES; i++)
+		if (psi[i].ok)
+			mvprintw( Y_PROCESSES+1+i, X_PROCESSES_1, 
+					"%-9s%5.1f%%  %5.1f%%   ", psi[i].name, psi[i].some,
+					psi[i].full);
+		else
+			mvprintw( Y_PROCESSES+1+i, X_PROCESSES_1, "%-9s%-17s", 
+					psi[i].name, "-");
+
+	mvprintw( Y_PROCESSES+4, X_PROCESSES_1, "%-9s%6.0f/s%9s", "majflt", 
+			v->rate[VM_MAJFLT], "");
+	mvprintw( Y_PROCESSES+5, X_PROCESSES_1, "%-9s%6.0f/s%5.0f out", 
+			"swap in", v->rate[VM_PSWPIN], v->rate[VM_PSWPOUT]);
+	mvprintw( Y_PROCESSES+6, X_PROCESSES_1, "%-9s%6.0f/s%5.0f stl", 
+			"scan", v->rate[VM_PGSCAN], v->rate[VM_PGSTEAL]);
+	mvprintw( Y_PROCESSES+7, X_PROCESSES_1, "%-9s%7llu %9s", "oom kill", 
+			v->v[VM_OOM], "");
+	mvprintw( Y_PROCESSES+8, X_PROCESSES_1, "%-9s%6.0f/s%9s", "ctxt", 
+			v->rate[VM_CTXT], "");
+	mvprintw( Y_PROCESSES+9, X_PROCESSES_1, "%-9s%6.0f/s%9s", "forks", 
+			v->rate[VM_FORKS], "");
+	for (i=10; i<MAX_SHOWPROCESSES; i++)
+		mvprintw( Y_PROCESSES+i, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * show_events: Show the kernel events, the last one first, with the time
+ * they happened. The arrow and page keys scroll. */
+
+void show_events( void)
+{
+	int i, y;
+	struct event_info * e;
+	time_t t;
+
+	if (!nevents)
+		mvprintw( Y_PROCESSES, X_PROCESSES_1, "%-26s", "No kernel events");
+	for (i=events_top, y=0; (i < nevents) && (y < MAX_SHOWPROCESSES); 
+			i++, y++) {
+		e = events + (events_next - 1 - i + KMSG_HISTORY) % KMSG_HISTORY;
+		t = e->t;
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, "%02d:%02d %-20.20s",
+				localtime( &t)->tm_hour, localtime( &t)->tm_min, e->text);
+	}
+	for (y=nevents ? y : 1; y<MAX_SHOWPROCESSES; y++)
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * sparkline: Draw the `n' values in `v' in `buf', scaled to `max'. A value
+ * of -1 means there are no samples, and is left blank. */
+
+void sparkline( char * buf, double * v, int n, double max)
+{
+	char * ramp = "_.-=+*#";
+	int i;
+
+	for (i=0; i<n; i++)
+		if (v[i] < 0)
+			buf[i] = ' ';
+		else if (max <= 0)
+			buf[i] = ramp[0];
+		else
+			buf[i] = ramp[(int) (v[i] / max * (strlen( ramp) - 1) + 0.5)];
+	buf[n] = '\000';
+}
+
+/* ------------------------------------------------------------------------
+ * show_history: Show the history of the system metrics, and of the CPU
+ * usage or RSS of the processes that are on top now, as sparklines over
+ * the span of the tier of `histmode'. The maximum is shown after them. */
+
+void show_history( void)
+{
+	char spark[HIST_WIDTH+1], val[16];
+	double cols[HIST_WIDTH], max;
+	int i, j, y, tier, kind;
+
+	tier = histmode % HIST_NTIERS;
+	kind = (histmode < HISTMODE_RSS_1S) ? HIST_CPU : HIST_RSS;
+	for (i=y=0; i<HIST_NSYS; i++, y++) {
+		max = hist_fetch( i, tier, cols, HIST_WIDTH);
+		sparkline( spark, cols, HIST_WIDTH, max);
+		switch (i) {
+		case HIST_SYS_CPU:
+			sprintf( val, "%4.0f%%", max);
+			break;
+		case HIST_SYS_LOAD:
+			sprintf( val, "%5.2f", max);
+			break;
+		default:
+			fmt_short( val, max);
+			break;
+		}
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, "%-5.5s %s %5s", 
+				series[i].name, spark, val);
+	}
+
+	for (i=0; (i < nprocs) && (y < MAX_SHOWPROCESSES); i++) {
+		if (((j = proc_lookup( pids[i])) == -1) || (procs[j].hist_cpu == -1))
+			continue;
+		j = (kind == HIST_CPU) ? procs[j].hist_cpu : procs[j].hist_rss;
+		max = hist_fetch( j, tier, cols, HIST_WIDTH);
+		sparkline( spark, cols, HIST_WIDTH, max);
+		if (kind == HIST_CPU)
+			sprintf( val, "%4.0f%%", max);
+		else
+			fmt_short( val, max);
+		mvprintw( Y_PROCESSES+y++, X_PROCESSES_1, "%-5.5s %s %5s", 
+				series[j].name, spark, val);
+	}
+	for (; y<MAX_SHOWPROCESSES; y++)
+		mvprintw( Y_PROCESSES+y, X_PROCESSES_1, EMPTY);
+}
+
+/* ------------------------------------------------------------------------
+ * fmt_time: Format a time in microseconds in five characters. */
+
+char * fmt_time( char * buf, unsigned long us)
+{
+	if (us >= 100000000)
+		sprintf( buf, "%4.0fs", us / 1e6);
+	else if (us >= 10000000)
+		sprintf( buf, "%4.1fs", us / 1e6);
+	else if (us >= 100000)
+		sprintf( buf, "%4.2fs", us / 1e6);
+	else if (us >= 1000)
+		sprintf( buf, "%4.1fm", us / 1e3);
+	else
+		sprintf( buf, "%4luu", us);
+	return (buf);
+}
+
+/* ------------------------------------------------------------------------
+ * show_profile: Show the profile overlay: our own CPU usage and system
+ * calls per update, and the time of each stage in the last update, and
+ * its median and 99th percentile. Stages that take no measurable time,
+ * such as those of the pages that are not shown, are left out. */
+
+void show_profile( void)
+{
+	int i, y;
+	unsigned long p99;
+	double age;
+	char buf[3][32], label[16];
+
+	mvprintw( 1, 0, "Self: %5.1f%% CPU %5ld r/w", self_cpu, 
+			self_rwcalls);
+	attrset( A_BOLD);
+	mvprintw( 2, 0, "%-9s%5s %5s %5s", "Stage", "Last", "p50", "p99");
+	attrset( 0);
+	for (i=0, y=3; (i < NSTAGES) && (y < 22); i++) {
+		p99 = prof_percentile( i, 99);
+		if (!p99 && (stages[i].last < 1e-6))
+			continue;
+
+		/* A source with a period of its own shows how old it is */
+
+		if ((age = source_age( i)) < 0)
+			sprintf( label, "%-9.9s", stages[i].label);
+		else
+			sprintf( label, "%-5.5s %s ", stages[i].label, 
+					fmt_age( buf[0], age));
+		mvprintw( y++, 0, "%s%s %s %s", label,
+				fmt_time( buf[0], stages[i].last * 1e6),
+				fmt_time( buf[1], prof_percentile( i, 50)),
+				fmt_time( buf[2], p99));
+	}
+	for (; y<22; y++)
+		mvprintw( y, 0, EMPTY);
+}
+
 /* ------------------------------------------------------------------------
  * show_logins: Show the number of tty-logins/x-logins.  */
 
@@ -304,6 +1189,12 @@ void show_cpu( void)
 	mvprintw( Y_CPUU, X_CPUU, "%5.1f%%U", cpu.pct_user + cpu.pct_nice); 
 	mvprintw( Y_CPUS, X_CPUS, "%5.1f%%S", cpu.pct_system); 
 	mvprintw( Y_CPUI, X_CPUI, "%5.1f%%I", cpu.pct_idle); 
+
+	/* The run queue wait, on the first line the groups leave free */
+
+	if (cpu.runq_ok && (ngroups < MAX_GROUPS))
+		mvprintw( Y_RUNQ+ngroups, X_RUNQ, "Runq:%6.0fms/s  max%5.0f ", 
+				cpu.runq_wait, cpu.runq_max);
 }
 
 /* ------------------------------------------------------------------------
@@ -337,11 +1228,50 @@ void show_messages( void)
 
 void show_flags( void)
 {
-	char str[32];
+	char str[32], pstr[16];
+	struct mode * s;
 
-	sprintf( str, "--%s-%s-%s-------%s--", sortmodes[sort].s, 
-			infomodes[info].s, memmodes[memory].s, 
-			rootflag ? "ROOT" : "----");
+	switch (page) {
+	case PAGE_CGROUPS:
+		s = cgsortmodes + cgsort;
+		break;
+	case PAGE_MOUNTS:
+		s = fssortmodes + fssort;
+		break;
+	case PAGE_DISKS:
+		s = disksortmodes + disksort;
+		break;
+	case PAGE_NET:
+		s = netsortmodes + netsort;
+		break;
+	case PAGE_SOCK:
+		s = socksortmodes + socksort;
+		break;
+	case PAGE_HIST:
+		s = histmodes + histmode;
+		break;
+	case PAGE_USERS:
+	case PAGE_GROUPS:
+	case PAGE_SESSIONS:
+		s = aggrsortmodes + aggrsort;
+		break;
+	case PAGE_TREE:
+		s = treesortmodes + treesort;
+		break;
+	case PAGE_THREADS:
+		s = threadsortmodes + threadsort;
+		break;
+	default:
+		s = sortmodes + sort;
+		break;
+	}
+	if (period < 99.95)
+		sprintf( pstr, "%4.1fs", period);
+	else
+		sprintf( pstr, "%4.0fs", period);
+	sprintf( str, "-%s-%s-%s-%s-%c%c%c-%s", s->s, infomodes[info].s,
+			memmodes[memory].s, pagemodes[page].s, filter_expr ? 'F' : '-',
+			rootflag ? 'R' : '-', budget > 0 ? 'B' : '-', pstr);
 	mvaddstr( Y_FLAGS, X_FLAGS, str);
 }
 
@@ -350,9 +1280,60 @@ void show_flags( void)
 
 void screen_update( void) 
 {
+	if (profile) {
+		title( "Profile for %s", Hostname);
+		show_profile();
+		show_messages();
+		refresh();
+		return;
+	}
 	title( "Information for %s", Hostname);
-	sort_procs();
-	show_procs();
+	switch (page) {
+	case PAGE_CGROUPS:
+		show_cgroups();
+		break;
+	case PAGE_MOUNTS:
+		show_mounts();
+		break;
+	case PAGE_DISKS:
+		show_disks();
+		break;
+	case PAGE_NET:
+		show_net();
+		break;
+	case PAGE_SOCK:
+		show_sockets();
+		break;
+	case PAGE_PSI:
+		show_psi();
+		break;
+	case PAGE_EVENTS:
+		show_events();
+		break;
+	case PAGE_HIST:
+		prof_begin( STAGE_SORT); sort_procs(); prof_end( STAGE_SORT);
+		show_history();
+		break;
+	case PAGE_USERS:
+		show_aggr( AGGR_USER);
+		break;
+	case PAGE_GROUPS:
+		show_aggr( AGGR_GROUP);
+		break;
+	case PAGE_SESSIONS:
+		show_aggr( AGGR_SESSION);
+		break;
+	case PAGE_TREE:
+		show_tree();
+		break;
+	case PAGE_THREADS:
+		show_threads();
+		break;
+	default:
+		prof_begin( STAGE_SORT); sort_procs(); prof_end( STAGE_SORT);
+		show_procs();
+		break;
+	}
 	show_cpu();
 	show_loads();
 	show_mem();
@@ -540,13 +1521,20 @@ char * get_string( const char * prompt, char c)
 }
 
 /* ------------------------------------------------------------------------
- * select_process: Let the user select a process with the arrow-keys. */
+ * select_process: Let the user select a process with the arrow-keys. Only
+ * the process, tree and threads pages have a process on every line; the
+ * other pages leave `pids' as it was. */
 
 int select_process( void)
 {
 	int i, c, old;
 	char line[SCREEN_WIDTH+1];
 
+	if (profile || ((page != PAGE_PROCS) && (page != PAGE_TREE) && 
+			(page != PAGE_THREADS))) {
+		notice( "No processes on this page");
+		return (-1);
+	}
 	i = 0; old = 0;
 	msg( "up/down, q)uit, enter=go");
 	mvinnstr( Y_PROCESSES, 0, line, SCREEN_WIDTH);
@@ -577,6 +1565,10 @@ int select_process( void)
 		}
 	}
 	msg( "");
+	if (pids[i] < 0) {
+		notice( "Process has exited");
+		return (-1);
+	}
 	return (i);
 }
 	
@@ -661,7 +1653,7 @@ void let_user_write( void)
 	refresh();
 	if ((i = select_process()) == -1)
 		return;
-	sprintf( fdname, "/proc/%d/fd/1", pids[i]);
+	sprintf( fdname, "%s/%d/fd/1", procroot, pids[i]);
 
 	if (!(f = fopen( fdname, "w"))) {
 		if (errno == EACCES)
@@ -680,6 +1672,66 @@ void let_user_write( void)
 }
 
 
+/* ------------------------------------------------------------------------
+ * let_user_collapse: Let the user select a process in the tree, and
+ * collapse or expand its subtree. */
+
+void let_user_collapse( void)
+{
+	int i;
+
+	title( "Collapse process");
+	refresh();
+	if ((i = select_process()) == -1)
+		return;
+	if (tree_collapse( pids[i]))
+		notice( "No children");
+}
+
+/* ------------------------------------------------------------------------
+ * let_user_watch: Let the user select a process, and put it on the watch
+ * list or take it off. */
+
+void let_user_watch( void)
+{
+	int i;
+
+	title( "Watch process");
+	refresh();
+	if ((i = select_process()) == -1)
+		return;
+	switch (watch_toggle( pids[i])) {
+	case 1:
+		notice( "Watched");
+		break;
+	case 0:
+		notice( "Not watched");
+		break;
+	default:
+		notice( nwatched == WATCH_MAX ? "Watch list full" : "Gone");
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * let_user_threads: Let the user select a process, and show its threads. */
+
+void let_user_threads( void)
+{
+	int i;
+
+	title( "Show threads");
+	refresh();
+	if ((i = select_process()) == -1)
+		return;
+	if (thread_select( pids[i]))
+		notice( "No threads");
+	else {
+		page = PAGE_THREADS;
+		notice( "%d threads", nthreads);
+	}
+}
+
+
 /* ------------------------------------------------------------------------
  * let_user_renice: Let the user select a process, prompt for a value and
  * renice the selected process to this value. Too high or too low values
@@ -714,30 +1766,71 @@ void let_user_renice( void)
 	notice( "priority set");
 }
 	
+/* ------------------------------------------------------------------------
+ * wake_add: Register `fd' as a wake descriptor: when it is readable
+ * (`events' is POLLIN) or has an exceptional condition (POLLPRI),
+ * xgetch() returns. Returns its index, or -1 if there are too many. */
+
+int wake_add( int fd, short events)
+{
+	if (nwake == MAX_WAKE)
+		return (-1);
+	wake_fds[nwake] = fd;
+	wake_events[nwake] = events;
+	wake_flags[nwake] = 0;
+	return (nwake++);
+}
+
+/* ------------------------------------------------------------------------
+ * wake_ready: Return nonzero if wake descriptor `i' fired since the last
+ * call. */
+
+int wake_ready( int i)
+{
+	int ready;
+
+	ready = wake_flags[i];
+	wake_flags[i] = 0;
+	return (ready);
+}
+
 /* ------------------------------------------------------------------------
  * xgetch: Get a character stroke from the user. 'tmout' is the time to block
  * in tenth of seconds. If 'ignoresignals' is zero, we return on a signal. 
- * If nonzero, we signals are ingnored. */
+ * If nonzero, we signals are ingnored. When we return on signals, we
+ * also return XGETCH_WAKE when a wake descriptor fires. */
 
 int xgetch( int tmout, int ignoresignals)
 {
-	fd_set rfds;
+	fd_set rfds, efds;
 	struct timeval tv;
-	int retval;
+	int retval, maxfd, i;
 	int c;
 	
 	tv.tv_sec = tmout / 10;
 	tv.tv_usec = (tmout % 10) * 100000;
 	FD_ZERO( &rfds);
 	FD_SET( STDIN_FILENO, &rfds);
-	while (((retval = select( 1, &rfds, NULL, NULL, &tv)) == -1) &&
+	FD_ZERO( &efds);
+	maxfd = STDIN_FILENO;
+	for (i=0; !ignoresignals && (i<nwake); i++) {
+		FD_SET( wake_fds[i], wake_events[i] == POLLIN ? &rfds : &efds);
+		if (wake_fds[i] > maxfd)
+			maxfd = wake_fds[i];
+	}
+	while (((retval = select( maxfd+1, &rfds, NULL, &efds, &tv)) == -1) &&
 	        (ignoresignals) && (errno == EINTR));
-	if (retval == 1) {
-		if ((c = getch()) != ERR)
-			return (c);
-		else
-			return (-1);
-	} else
+	if (retval <= 0)
+		return (-1);
+	for (i=0; !ignoresignals && (i<nwake); i++)
+		if (FD_ISSET( wake_fds[i], wake_events[i] == POLLIN ? &rfds : 
+				&efds))
+			wake_flags[i] = 1;
+	if (!FD_ISSET( STDIN_FILENO, &rfds))
+		return (XGETCH_WAKE);
+	if ((c = getch()) != ERR)
+		return (c);
+	else
 		return (-1);
 }
 		
@@ -806,25 +1899,25 @@ void show_help( void)
 	mvprintw( 2,  0, "    available in hifs:    ");
 	mvprintw( 3,  0, "--------------------------");
 	mvprintw( 4,  0, "s - Toggle sorting mode   ");
-	mvprintw( 5,  0, "    (cpu/rss/vsize)       ");
+	mvprintw( 5,  0, "c - Collapse a tree branch");
 	mvprintw( 6,  0, "i - Toggle info mode      ");
-	mvprintw( 7,  0, "    (pid/cmd/wchan/name/  ");
-	mvprintw( 8,  0, "    prio)                 ");
+	mvprintw( 7,  0, "    (pid/cmd/wchan/...)   ");
+	mvprintw( 8,  0, "t - Show threads of a proc");
 	mvprintw( 9,  0, "m - Toggle memory mode    ");
-	mvprintw( 10, 0, "    (free/used)           ");
-	mvprintw( 11, 0, "                          ");
+	mvprintw( 10, 0, "W - Watch/unwatch a proc  ");
+	mvprintw( 11, 0, "f - Set process filter    ");
 	mvprintw( 12, 0, "k - Select and kill a proc");
 	mvprintw( 13, 0, "K - Select and KILL a proc");
 	mvprintw( 14, 0, "w - Write a msg to a proc ");
 	mvprintw( 15, 0, "p - Set priority of a proc");
-	mvprintw( 16, 0, "                          ");
+	mvprintw( 16, 0, "v - Cycle through pages   ");
 	mvprintw( 17, 0, "u - Set update period     ");
 #ifdef CONFIG_SU
 	mvprintw( 18, 0, "r - Toggle su to root     ");
 #else
 	mvprintw( 18, 0, "                          ");
 #endif
-	mvprintw( 19, 0, "                          ");
+	mvprintw( 19, 0, "D - Toggle profile overlay");
 	mvprintw( 20, 0, "CTRL-L - redraw screen    ");
 	mvprintw( 21, 0, "q - quit hifs             ");
 	mvprintw( 22, 0, "--------------------------");
@@ -842,6 +1935,7 @@ int screen_init( int i)
 {
 	char buf[BUFSIZ];
 	int row, col, j;
+	FILE * f;
 
 	if (!i) {
 		gethostname( buf, BUFSIZ);
@@ -855,7 +1949,17 @@ int screen_init( int i)
 
 		messages = xmalloc( messages_size * sizeof (struct msg_entry));
 
-		initscr(); noecho(); cbreak(); keypad( stdscr, TRUE);
+		/* A benchmark renders to /dev/null */
+
+		if (bench) {
+			if (!(f = fopen( "/dev/null", "w")) || 
+					!newterm( "vt100", f, stdin)) {
+				fprintf( stderr, "Can't set up a terminal for the benchmark\n");
+				return (1);
+			}
+		} else
+			initscr(); 
+		noecho(); cbreak(); keypad( stdscr, TRUE);
 		getmaxyx( stdscr, row, col);
 		if ((row < SCREEN_HEIGHT) || (col < SCREEN_WIDTH)) {
 			endwin();
@@ -0,0 +1,301 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * sock.c: Socket counts per state and listen queues, from the kernel's
+ * sock_diag netlink interface. Parsing /proc/net/tcp takes seconds on a
+ * host with hundreds of thousands of sockets. Here the kernel only dumps
+ * the TCP states that are normally rare; the established and TIME_WAIT
+ * counts and the UDP count come from /proc/net/sockstat, and the unix
+ * count from /proc/net/protocols, so no socket that is common crosses
+ * netlink. This is done every SOCK_INTERVAL seconds, while the sockets
+ * page is shown; the period is kept in source.c.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int					sock_fd			= -1;	/* sock_diag netlink socket */
+int					sock_seq		= 0;	/* last request sequence #	*/
+int					sockstat_fd		= -1;	/* open /proc/net/sockstat	*/
+int					sockstat6_fd	= -1;	/* open /proc/net/sockstat6	*/
+int					protocols_fd	= -1;	/* open /proc/net/protocols	*/
+int					sockstat_size	= 0;	/* size of sockstat_buf		*/
+int					nlistens		= 0;	/* # of ports listened on	*/
+int					listens_size	= 16;	/* size of listen table		*/
+char *				sock_buf		= NULL;	/* netlink receive buffer	*/
+char *				sockstat_buf	= NULL;	/* sockstat file contents	*/
+
+struct sock_stats	sockstats;					/* socket counts		*/
+struct listen_info *	listens		= NULL;	/* listen queues by port	*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+int			sock_dump			(int, unsigned);
+void		sock_count			(struct nlmsghdr *);
+void		listen_add			(int, unsigned long, unsigned long);
+long		sockstat_get		(const char *, const char *, const char *);
+int			read_sockstat		(void);
+int			listen_comp			(const struct listen_info *,
+								 const struct listen_info *);
+
+/* ------------------------------------------------------------------------
+ * listen_add: Account a listening socket on `port' with `queue' pending
+ * connections out of `backlog'. Sockets on the same port are added up. */
+
+void listen_add( int port, unsigned long queue, unsigned long backlog)
+{
+	struct listen_info * l;
+	int i;
+
+	for (i=0; (i < nlistens) && (listens[i].port != port); i++);
+	if (i == nlistens) {
+		if (nlistens == listens_size)
+			listens = xrealloc( listens, (listens_size *= 2) *
+					sizeof (struct listen_info));
+		l = listens + nlistens++;
+		memset( l, 0, sizeof (struct listen_info));
+		l->port = port;
+	} else
+		l = listens + i;
+	l->nsocks++;
+	l->queue += queue;
+	l->backlog += backlog;
+}
+
+/* ------------------------------------------------------------------------
+ * sock_count: Count the TCP socket in netlink message `h'. */
+
+void sock_count( struct nlmsghdr * h)
+{
+	struct inet_diag_msg * m;
+
+	m = NLMSG_DATA( h);
+	if (m->idiag_state < SOCK_NSTATES)
+		sockstats.tcp[m->idiag_state]++;
+	if (m->idiag_state == TCP_LISTEN)
+		listen_add( ntohs( m->id.idiag_sport), m->idiag_rqueue,
+				m->idiag_wqueue);
+}
+
+/* ------------------------------------------------------------------------
+ * sock_dump: Ask the kernel for the TCP sockets of `family' that are in
+ * one of `states', a bit mask of TCP states, and count them. Returns
+ * nonzero on error, with errno set. A receive that waits longer than
+ * SOCK_TIMEOUT seconds is an error too, so that a stalled dump does not
+ * hang the update. */
+
+int sock_dump( int family, unsigned states)
+{
+	struct sockaddr_nl sa;
+	struct {
+		struct nlmsghdr nlh;
+		struct inet_diag_req_v2 r;
+	} req;
+	struct nlmsghdr * h;
+	int n;
+
+	memset( &req, 0, sizeof (req));
+	req.nlh.nlmsg_len = sizeof (req);
+	req.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+	req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nlh.nlmsg_seq = ++sock_seq;
+	req.r.sdiag_family = family;
+	req.r.sdiag_protocol = IPPROTO_TCP;
+	req.r.idiag_states = states;
+	memset( &sa, 0, sizeof (sa));
+	sa.nl_family = AF_NETLINK;
+	if (sendto( sock_fd, &req, sizeof (req), 0, (struct sockaddr *) &sa,
+			sizeof (sa)) == -1)
+		return (1);
+
+	/* The dump comes in many datagrams, each holding many messages */
+
+	for (;;) {
+		if ((n = recv( sock_fd, sock_buf, SOCK_BUFSIZE, 0)) == -1) {
+			if (errno == EINTR)
+				continue;
+			return (1);
+		}
+		for (h=(struct nlmsghdr *) sock_buf; NLMSG_OK( h, n);
+				h=NLMSG_NEXT( h, n)) {
+			if (h->nlmsg_seq != sock_seq)
+				continue;
+			switch (h->nlmsg_type) {
+			case NLMSG_DONE:
+				return (0);
+			case NLMSG_ERROR:
+				errno = -((struct nlmsgerr *) NLMSG_DATA( h))->error;
+				return (1);
+			default:
+				sock_count( h);
+				break;
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * sockstat_get: Return the value of `key' on the line starting with
+ * `prefix' in `buf', which holds /proc/net/sockstat. */
+
+long sockstat_get( const char * buf, const char * prefix, const char * key)
+{
+	const char * p;
+	int plen, klen;
+
+	plen = strlen( prefix);
+	klen = strlen( key);
+	for (p=buf; p && strncmp( p, prefix, plen); )
+		if ((p = strchr( p, '\n')))
+			p++;
+	if (!p)
+		return (0);
+	for (p+=plen; *p && (*p != '\n'); p++)
+		if ((p[-1] == ' ') && !strncmp( p, key, klen) && (p[klen] == ' '))
+			return (atol( p + klen));
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_sockstat: Read the TCP sockets in use and in TIME_WAIT and the UDP
+ * sockets from /proc/net/sockstat and sockstat6, and the unix sockets
+ * from /proc/net/protocols. Newer kernels count unix stream sockets on a
+ * line of their own there. */
+
+int read_sockstat( void)
+{
+	char fname[FILENAME_MAX];
+	char * p;
+	long n;
+
+	sprintf( fname, "%s/net/sockstat", procroot);
+	if (readfile( fname, &sockstat_fd, &sockstat_buf, &sockstat_size) == -1)
+		return (1);
+	sockstats.inuse = sockstat_get( sockstat_buf, "TCP:", "inuse");
+	sockstats.tw = sockstat_get( sockstat_buf, "TCP:", "tw");
+	sockstats.udp = sockstat_get( sockstat_buf, "UDP:", "inuse");
+
+	sprintf( fname, "%s/net/sockstat6", procroot);
+	if (readfile( fname, &sockstat6_fd, &sockstat_buf, &sockstat_size) 
+			!= -1) {
+		sockstats.inuse += sockstat_get( sockstat_buf, "TCP6:", "inuse");
+		sockstats.udp += sockstat_get( sockstat_buf, "UDP6:", "inuse");
+	}
+
+	sockstats.unx = 0;
+	sprintf( fname, "%s/net/protocols", procroot);
+	if (readfile( fname, &protocols_fd, &sockstat_buf, &sockstat_size) 
+			== -1)
+		return (0);
+	for (p=sockstat_buf; p; ) {
+		if (!strncmp( p, "UNIX", 4) && (sscanf( p, "%*s %*d %ld", &n) == 1))
+			sockstats.unx += n;
+		if ((p = strchr( p, '\n')))
+			p++;
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * read_sockets: Update the socket counts and listen queues. Only done
+ * while the sockets page is shown. It is a source with a period of
+ * SOCK_INTERVAL seconds, and is read at once when the page is shown. */
+
+int read_sockets( void)
+{
+	struct timeval tv;
+	long n;
+	int i;
+
+	if (page != PAGE_SOCK)
+		return (0);
+
+	if (sock_fd == -1) {
+		if ((sock_fd = socket( AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC,
+				NETLINK_SOCK_DIAG)) == -1) {
+			queue_msg( MAX_PRIO, "sock_diag: %s", strerror( errno));
+			sockstats.ok = 0;
+			return (1);
+		}
+		tv.tv_sec = SOCK_TIMEOUT;
+		tv.tv_usec = 0;
+		setsockopt( sock_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+	}
+
+	/* A kernel without IPv6 has no IPv6 sockets to dump */
+
+	memset( sockstats.tcp, 0, sizeof (sockstats.tcp));
+	nlistens = 0;
+	if (sock_dump( AF_INET, SOCK_TCP_STATES) ||
+			(sock_dump( AF_INET6, SOCK_TCP_STATES) &&
+			(errno != EAFNOSUPPORT) && (errno != ENOENT))) {
+		queue_msg( MAX_PRIO, "sock_diag: %s", strerror( errno));
+		close( sock_fd);
+		sock_fd = -1;
+		sockstats.ok = 0;
+		return (1);
+	}
+
+	/* What is in use and was not dumped is established */
+
+	read_sockstat();
+	for (i=n=0; i<SOCK_NEW_SYN_RECV; i++)
+		n += sockstats.tcp[i];
+	sockstats.tcp[TCP_ESTABLISHED] = (sockstats.inuse > n) ?
+			sockstats.inuse - n : 0;
+	sockstats.tcp[TCP_TIME_WAIT] = sockstats.tw;
+	sockstats.ok = 1;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * listen_comp: Compare two listen queues according to `socksort'. Used
+ * with qsort(). */
+
+int listen_comp( const struct listen_info * a, const struct listen_info * b)
+{
+	double ka, kb;
+
+	switch (socksort) {
+	case SOCKSORT_QUEUE:
+		ka = a->queue;
+		kb = b->queue;
+		break;
+	case SOCKSORT_PORT:
+		return (a->port - b->port);
+	case SOCKSORT_FILL:
+	default:
+		ka = a->backlog ? (double) a->queue / a->backlog : 0;
+		kb = b->backlog ? (double) b->queue / b->backlog : 0;
+		if (ka == kb)
+			return (a->port - b->port);
+		break;
+	}
+	return ((ka < kb) - (ka > kb));
+}
+
+/* ------------------------------------------------------------------------
+ * listen_sort: Sort the listen queues according to `socksort'. */
+
+void listen_sort( void)
+{
+	qsort( listens, nlistens, sizeof (struct listen_info),
+			(int (*)(const void *, const void *)) listen_comp);
+}
+
+/* ------------------------------------------------------------------------
+ * sock_init: Allocate the listen table and the netlink buffer. The
+ * netlink socket is opened on first use. */
+
+int sock_init( void)
+{
+	listens = xmalloc( listens_size * sizeof (struct listen_info));
+	sock_buf = xmalloc( SOCK_BUFSIZE);
+	memset( &sockstats, 0, sizeof (sockstats));
+	return (0);
+}
@@ -0,0 +1,139 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * source.c: The sources of data that an update reads. Most are read every
+ * update, but a source can have a period of its own: the load averages
+ * only change every 5 seconds, and utmp hardly ever. The sources that are
+ * due are read in order, except that once SOURCE_SPREAD seconds were
+ * spent on them, the rest wait for the next update. So sources that fall
+ * due together are spread over several updates. Every source remembers
+ * when it was last read.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+/* The sources, in the order they are read. The cost is a first guess, and
+ * is measured after that. The free space and the sockets change slowly and
+ * are costly on large hosts, so they have periods of their own too. The
+ * per process sources read a share of the processes each update, and the
+ * cgroups and the history keep rates and 1 second samples, so those are
+ * read every update. */
+
+struct source_info sources[NSOURCES] = {
+	{ "procs", STAGE_PROCS, read_procs, 0, 0.01 },
+	{ "procio", STAGE_PROCIO, read_procio, 0, 0.001 },
+	{ "procpss", STAGE_PROCPSS, read_procpss, 0, 0.001 },
+	{ "procsched", STAGE_PROCSCHED, read_procsched, 0, 0.001 },
+	{ "cgroups", STAGE_CGROUPS, cgroup_update, 0, 0.001 },
+	{ "cpu", STAGE_CPU, read_cpu, 0, 0.0001 },
+	{ "schedstat", STAGE_SCHEDSTAT, read_schedstat, 0, 0.0001 },
+	{ "loads", STAGE_LOADS, read_loads, 5, 0.0001 },
+	{ "mem", STAGE_MEM, read_mem, 0, 0.0001 },
+	{ "logins", STAGE_LOGINS, read_logins, 15, 0.0001 },
+	{ "diskfree", STAGE_DISKFREE, check_diskfree, 10, 0.0001 },
+	{ "disks", STAGE_DISKS, read_disks, 0, 0.0001 },
+	{ "net", STAGE_NET, read_net, 0, 0.0001 },
+	{ "sockets", STAGE_SOCK, read_sockets, SOCK_INTERVAL, 0.001 },
+	{ "psi", STAGE_PSI, read_psi, 0, 0.0001 },
+	{ "history", STAGE_HIST, hist_update, 0, 0.0001 }
+};
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+double		source_run			(struct source_info *);
+
+/* ------------------------------------------------------------------------
+ * source_run: Read source `s' and return the time it took. The jiffies
+ * are the ticks since it was last read, so that its rates are over its
+ * own period. */
+
+double source_run( struct source_info * s)
+{
+	double t;
+
+	jiffies = (update_t - s->last) * clk_tck;
+	t = stages[s->stage].tick;
+	prof_begin( s->stage);
+	s->update();
+	prof_end( s->stage);
+	t = stages[s->stage].tick - t;
+
+	s->cost += (t - s->cost) * SOURCE_WEIGHT;
+	s->last = update_t;
+	if (s->period) {
+		s->next += s->period;
+		if (s->next <= update_t)
+			s->next = update_t + s->period;
+	}
+	return (t);
+}
+
+/* ------------------------------------------------------------------------
+ * source_update: Read the sources that are due. A source with a period of
+ * its own waits for the next update when it would make the time spent on
+ * such sources exceed SOURCE_SPREAD, unless it is a full period late. */
+
+void source_update( void)
+{
+	struct source_info * s;
+	double spent;
+
+	for (s=sources, spent=0; s<sources+NSOURCES; s++) {
+		if (!s->period || !s->last)
+			source_run( s);
+		else if (s->next > update_t)
+			continue;
+		else if (spent && (spent + s->cost > SOURCE_SPREAD) &&
+				(update_t - s->next < s->period))
+			continue;
+		else
+			spent += source_run( s);
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * source_set: Set the period of the source called `name', in seconds. 0
+ * reads it every update. Returns nonzero if there is no such source. */
+
+int source_set( const char * name, double period)
+{
+	int i;
+
+	for (i=0; (i < NSOURCES) && strcmp( sources[i].name, name); i++);
+	if ((i == NSOURCES) || (period < 0))
+		return (1);
+	sources[i].period = period;
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * source_due: Let the source called `name' be read in the next update. */
+
+void source_due( const char * name)
+{
+	int i;
+
+	for (i=0; (i < NSOURCES) && strcmp( sources[i].name, name); i++);
+	if (i < NSOURCES)
+		sources[i].next = 0;
+}
+
+/* ------------------------------------------------------------------------
+ * source_age: Return the seconds since the source of profile stage `stage'
+ * was read, or -1 if it has no period of its own. */
+
+double source_age( int stage)
+{
+	int i;
+
+	for (i=0; i<NSOURCES; i++)
+		if ((sources[i].stage == stage) && sources[i].period)
+			return (sources[i].last ? update_t - sources[i].last : -1);
+	return (-1);
+}
@@ -0,0 +1,283 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * thread.c: The threads of one selected process, from /proc/<pid>/task.
+ * They are sampled every THREAD_PERIOD seconds by a timer that wakes up
+ * xgetch(), apart from the update of the process table, and only while
+ * the threads page is shown. The task directory and the stat, schedstat
+ * and wchan files of every thread are kept open between samples. The
+ * update in the SIGALRM handler moves the process table and queues
+ * messages, so that signal is blocked while a process is looked up and
+ * while the main loop takes a sample.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct thread_info *	threads		= NULL;	/* threads of thread_pid	*/
+
+int					nthreads		= 0;	/* # of threads				*/
+int					threads_size	= 64;	/* initial thread table size */
+int					thread_pid		= 0;	/* selected process, or 0	*/
+char				thread_comm[PINFO_COMM_SIZE];	/* and its command	*/
+int					thread_timer	= -1;	/* timerfd for the samples	*/
+int					thread_wake_i	= -1;	/* its wake descriptor		*/
+int					thread_serial	= 0;	/* # of samples taken		*/
+int					thread_bufsize	= 0;	/* size of thread_buf		*/
+double				thread_t		= 0;	/* time of the last sample	*/
+char *				thread_buf		= NULL;	/* contents of a file		*/
+DIR *				thread_dir		= NULL;	/* open task directory		*/
+int					thread_nosched	= 0;	/* Kernel has no schedstat	*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void		thread_arm			(double);
+void		thread_close		(int);
+int			read_thread			(struct thread_info *, double);
+int			thread_comp			(const int *, const int *);
+
+/* ------------------------------------------------------------------------
+ * thread_arm: Let the timer fire every `period' seconds, or stop it when
+ * `period' is zero. */
+
+void thread_arm( double period)
+{
+	struct itimerspec its;
+
+	if (thread_timer == -1)
+		return;
+	its.it_interval.tv_sec = (time_t) period;
+	its.it_interval.tv_nsec = (long) ((period - (time_t) period) * 1e9);
+	its.it_value = its.it_interval;
+	timerfd_settime( thread_timer, 0, &its, NULL);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_close: Close the files of thread `i' and remove it from the
+ * table. */
+
+void thread_close( int i)
+{
+	if (threads[i].fd != -1)
+		close( threads[i].fd);
+	if (threads[i].wchan_fd != -1)
+		close( threads[i].wchan_fd);
+	if (threads[i].sched_fd != -1)
+		close( threads[i].sched_fd);
+	threads[i] = threads[--nthreads];
+}
+
+/* ------------------------------------------------------------------------
+ * read_thread: Read the stat file of thread `t', and its wchan file if it
+ * is not running. The CPU usage is over the `dt' seconds since the last
+ * sample. It is taken from schedstat in nanoseconds if the kernel has it:
+ * half a second is only 50 ticks. */
+
+int read_thread( struct thread_info * t, double dt)
+{
+	char fname[FILENAME_MAX];
+	unsigned long utime, stime;
+	unsigned long long run;
+
+	sprintf( fname, "%s/%d/task/%d/stat", procroot, thread_pid, t->tid);
+	if (readfile( fname, &t->fd, &thread_buf, &thread_bufsize) == -1)
+		return (1);
+	if (sscanf( thread_buf, "%*d (%31[^)]) %c %*d %*d %*d %*d %*d %*u %*u "
+			"%*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u %*u %*d %*u "
+			"%*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*u %*d %d",
+			t->comm, &t->state, &utime, &stime, &t->cpu) != 5) {
+		queue_msg( MAX_PRIO, "%s: ? format", fname);
+		return (1);
+	}
+	sprintf( fname, "%s/%d/task/%d/schedstat", procroot, thread_pid, t->tid);
+	if (!thread_nosched && (readfile( fname, &t->sched_fd, &thread_buf, 
+			&thread_bufsize) > 0) && 
+			(sscanf( thread_buf, "%llu", &run) == 1)) {
+		if (t->run && (dt > 0))
+			t->pct_cpu = (run >= t->run) ? (run - t->run) * 100.0 / 
+					(dt * 1e9) : 0;
+		t->run = run;
+	} else if (t->serial && (dt > 0))
+		t->pct_cpu = (utime + stime - t->jiffies) * 100.0 / (clk_tck * dt);
+	t->jiffies = utime + stime;
+	t->serial = thread_serial;
+
+	/* The wchan in stat is zero on recent kernels */
+
+	strcpy( t->wchan, "-");
+	if (t->state == 'R')
+		return (0);
+	sprintf( fname, "%s/%d/task/%d/wchan", procroot, thread_pid, t->tid);
+	if (readfile( fname, &t->wchan_fd, &thread_buf, &thread_bufsize) > 0)
+		strnzcpy( t->wchan, thread_buf, PINFO_WCHAN_SIZE);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_sample: Read the threads of the selected process. New threads
+ * are added, and threads that are gone are removed. */
+
+int thread_sample( void)
+{
+	struct dirent * dentry;
+	double now, dt;
+	int i, k, tid;
+
+	if (!thread_dir)
+		return (1);
+	thread_serial++;
+	now = mono_time();
+	dt = now - thread_t;
+	thread_t = now;
+
+	/* The task directory lists the threads in the same order every time,
+	 * so a thread is looked for after the previous one first. */
+
+	rewinddir( thread_dir);
+	for (k=0; (dentry = readdir( thread_dir)); ) {
+		if (!(tid = atoi( dentry->d_name)))
+			continue;
+		for (i=k; (i < nthreads) && (threads[i].tid != tid); i++);
+		if (i == nthreads)
+			for (i=0; (i < k) && (i < nthreads) &&
+					(threads[i].tid != tid); i++);
+		if ((i == nthreads) || (threads[i].tid != tid)) {
+			if (nthreads == threads_size)
+				threads = xrealloc( threads, (threads_size *= 2) *
+						sizeof (struct thread_info));
+			i = nthreads++;
+			memset( threads+i, 0, sizeof (struct thread_info));
+			threads[i].tid = tid;
+			threads[i].fd = threads[i].wchan_fd = -1;
+			threads[i].sched_fd = -1;
+		}
+		read_thread( threads+i, dt);
+		k = i+1;
+	}
+	for (i=0; i<nthreads; i++)
+		if (threads[i].serial != thread_serial)
+			thread_close( i--);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_select: Show the threads of `pid'. Returns nonzero if its task
+ * directory cannot be read. */
+
+int thread_select( int pid)
+{
+	char fname[FILENAME_MAX];
+	sigset_t set, oset;
+	int i;
+
+	while (nthreads)
+		thread_close( 0);
+	if (thread_dir)
+		closedir( thread_dir);
+	thread_pid = pid;
+	sprintf( fname, "%s/%d/task", procroot, pid);
+	if (!(thread_dir = opendir( fname))) {
+		queue_msg( MAX_PRIO, "%s: %s", fname, strerror( errno));
+		thread_pid = 0;
+		return (1);
+	}
+	sprintf( fname, "%s/%d/schedstat", procroot, pid);
+	thread_nosched = access( fname, R_OK);
+	strcpy( thread_comm, "?");
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	if ((i = proc_lookup( pid)) != -1)
+		strnzcpy( thread_comm, procs[i].comm, PINFO_COMM_SIZE);
+	thread_sample();
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	thread_arm( THREAD_PERIOD);
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_wake: Called when xgetch() was woken by a wake descriptor. Takes
+ * a sample if the timer fired, and returns nonzero if it did. The timer
+ * is stopped when the threads page is no longer shown. */
+
+int thread_wake( void)
+{
+	unsigned long long n;
+	sigset_t set, oset;
+
+	if ((thread_wake_i == -1) || !wake_ready( thread_wake_i))
+		return (0);
+	if (read( thread_timer, &n, sizeof (n)) == -1)
+		return (0);
+	if ((page != PAGE_THREADS) || !thread_pid) {
+		thread_arm( 0);
+		return (0);
+	}
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	thread_sample();
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	return (1);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_comp: Compare two threads according to `threadsort'. Used with
+ * qsort(). */
+
+int thread_comp( const int * one, const int * two)
+{
+	struct thread_info * a = threads + *one, * b = threads + *two;
+
+	switch (threadsort) {
+	case THREADSORT_TIME:
+		return ((a->jiffies < b->jiffies) - (a->jiffies > b->jiffies));
+	case THREADSORT_TID:
+		return (a->tid - b->tid);
+	case THREADSORT_CPU:
+	default:
+		return ((a->pct_cpu < b->pct_cpu) - (a->pct_cpu > b->pct_cpu));
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * thread_sort: Store the indices of the top `max' threads in `top'.
+ * Returns the number of threads stored. */
+
+int thread_sort( int * top, int max)
+{
+	int i, * all;
+
+	all = xmalloc( (nthreads + 1) * sizeof (int));
+	for (i=0; i<nthreads; i++)
+		all[i] = i;
+	qsort( all, nthreads, sizeof (int),
+			(int (*)(const void *, const void *)) thread_comp);
+	if ((i = nthreads) > max)
+		i = max;
+	memcpy( top, all, i * sizeof (int));
+	free( all);
+	return (i);
+}
+
+/* ------------------------------------------------------------------------
+ * thread_init: Allocate the thread table and create the timer. Without a
+ * timer, the threads are sampled when the screen is drawn. */
+
+int thread_init( void)
+{
+	threads = xmalloc( threads_size * sizeof (struct thread_info));
+	thread_timer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK |
+			TFD_CLOEXEC);
+	if ((thread_timer != -1) &&
+			((thread_wake_i = wake_add( thread_timer, POLLIN)) == -1)) {
+		close( thread_timer);
+		thread_timer = -1;
+	}
+	return (0);
+}
@@ -0,0 +1,208 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * tree.c: The process tree. Every process is linked into the list of
+ * children of its parent, and keeps the CPU usage, RSS and number of
+ * processes of its subtree. A process is only relinked when its parent
+ * changes, and a change in its values is added to its ancestors, so an
+ * update costs nothing for the processes that did not change.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int				tree_root		= -1;	/* First process without parent */
+int				tree_mark		= 0;	/* Marks the processes shown */
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void		tree_add			(int, double, double, int);
+void		tree_link			(int);
+void		tree_unlink			(int);
+int			tree_walk			(int, int, int *, int *, int, int);
+
+/* ------------------------------------------------------------------------
+ * tree_add: Add `cpu', `rss' and `n' processes to the subtree of process
+ * `i' and of all its ancestors. */
+
+void tree_add( int i, double cpu, double rss, int n)
+{
+	for (; i != -1; i=procs[i].parent) {
+		procs[i].sub_cpu += cpu;
+		procs[i].sub_rss += rss;
+		procs[i].sub_n += n;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * tree_link: Link process `i' into the list of children of its parent.
+ * When the parent is not in the process table, or would be its own
+ * descendant, it is linked in as a root. */
+
+void tree_link( int i)
+{
+	struct process_info * p = procs + i;
+	int j;
+
+	j = p->ppid ? proc_lookup( p->ppid) : -1;
+	if ((j != -1) && (procs[j].serial != p->serial))
+		j = -1;
+	for (p->parent=j; j != -1; j=procs[j].parent)
+		if (j == i) {
+			p->parent = -1;
+			break;
+		}
+	if (p->parent == -1) {
+		p->sibling = tree_root;
+		tree_root = i;
+	} else {
+		p->sibling = procs[p->parent].child;
+		procs[p->parent].child = i;
+		tree_add( p->parent, p->sub_cpu, p->sub_rss, p->sub_n);
+	}
+	p->tree_ppid = p->ppid;
+}
+
+/* ------------------------------------------------------------------------
+ * tree_unlink: Take process `i' out of the list of children of its
+ * parent, together with its subtree. */
+
+void tree_unlink( int i)
+{
+	struct process_info * p = procs + i;
+	int * j;
+
+	j = (p->parent == -1) ? &tree_root : &procs[p->parent].child;
+	for (; *j != -1; j=&procs[*j].sibling)
+		if (*j == i) {
+			*j = p->sibling;
+			break;
+		}
+	if (p->parent != -1)
+		tree_add( p->parent, -p->sub_cpu, -p->sub_rss, -p->sub_n);
+	p->parent = -1;
+	p->tree_ppid = -1;
+}
+
+/* ------------------------------------------------------------------------
+ * tree_update: Bring process `i' up to date in the tree. It is relinked
+ * if its parent changed, and the change in its own values is added to
+ * its subtree and its ancestors. A process that the filter rejects counts
+ * for nothing. */
+
+void tree_update( int i)
+{
+	struct process_info * p = procs + i;
+	double cpu, rss;
+	int n;
+
+	if (p->tree_ppid != p->ppid) {
+		if (p->tree_ppid != -1)
+			tree_unlink( i);
+		tree_link( i);
+	}
+	cpu = p->filtered ? 0 : p->pct_cpu;
+	rss = p->filtered ? 0 : p->rss;
+	n = !p->filtered;
+	if ((cpu == p->tree_cpu) && (rss == p->tree_rss) && (n == p->tree_n))
+		return;
+	tree_add( i, cpu - p->tree_cpu, rss - p->tree_rss, n - p->tree_n);
+	p->tree_cpu = cpu;
+	p->tree_rss = rss;
+	p->tree_n = n;
+}
+
+/* ------------------------------------------------------------------------
+ * tree_remove: Process `i' exited. It is taken out of the tree, and its
+ * children become roots until they are given a new parent. */
+
+void tree_remove( int i)
+{
+	struct process_info * p = procs + i;
+	int j, next;
+
+	if (p->tree_ppid == -1)
+		return;
+	tree_add( i, -p->tree_cpu, -p->tree_rss, -p->tree_n);
+	tree_unlink( i);
+	for (j=p->child; j != -1; j=next) {
+		next = procs[j].sibling;
+		procs[j].parent = -1;
+		procs[j].sibling = tree_root;
+		tree_root = j;
+	}
+	p->child = -1;
+}
+
+/* ------------------------------------------------------------------------
+ * tree_walk: Store the processes in the list starting at `first' in `top',
+ * and their depth in `depth', from entry `n' on. Siblings are ordered by
+ * `treesort', each followed by its children unless it is collapsed.
+ * Subtrees without processes are left out. Returns the number of entries
+ * stored, at most `max'. */
+
+int tree_walk( int first, int d, int * top, int * depth, int n, int max)
+{
+	int i, k;
+	double v, vmax;
+
+	/* A kind of selection sort: only the siblings that are shown are
+	 * ever compared, and they are marked when taken. */
+
+	while (n < max) {
+		for (i=first, k=-1, vmax=0; i != -1; i=procs[i].sibling) {
+			if (!procs[i].sub_n || (procs[i].shown == tree_mark))
+				continue;
+			v = (treesort == TREESORT_RSS) ? procs[i].sub_rss :
+					procs[i].sub_cpu;
+			if ((k == -1) || (v > vmax)) {
+				vmax = v;
+				k = i;
+			}
+		}
+		if (k == -1)
+			break;
+		procs[k].shown = tree_mark;
+		top[n] = k;
+		depth[n++] = d;
+		if (!procs[k].collapsed)
+			n = tree_walk( procs[k].child, d+1, top, depth, n, max);
+	}
+	return (n);
+}
+
+/* ------------------------------------------------------------------------
+ * tree_sort: Store the first `max' processes of the tree in `top', and
+ * their depth in `depth'. Returns the number of processes stored. */
+
+int tree_sort( int * top, int * depth, int max)
+{
+	tree_mark++;
+	return (tree_walk( tree_root, 0, top, depth, 0, max));
+}
+
+/* ------------------------------------------------------------------------
+ * tree_collapse: Collapse the subtree of `pid', or expand it when it is
+ * collapsed. Returns nonzero if `pid' has no children. Called from the
+ * main loop, so SIGALRM is blocked: the update relinks the tree. */
+
+int tree_collapse( int pid)
+{
+	sigset_t set, oset;
+	int i, ret = 1;
+
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	if (((i = proc_lookup( pid)) != -1) && (procs[i].child != -1)) {
+		procs[i].collapsed = !procs[i].collapsed;
+		ret = 0;
+	}
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	return (ret);
+}
@@ -44,3 +44,59 @@ char * strnzcpy( char * dest, const char * src, size_t size)
 	return (dest);
 }
 	
+
+/* ------------------------------------------------------------------------
+ * mono_time: Return the time of the monotonic clock, in seconds. */
+
+double mono_time( void)
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/* ------------------------------------------------------------------------
+ * match_list: Return nonzero if `s' matches one of the shell patterns in
+ * `list'. The patterns are separated by spaces or commas. */
+
+int match_list( const char * list, const char * s)
+{
+	char pat[64];
+	int n;
+
+	while (*list) {
+		n = strcspn( list, " ,");
+		if (n && (n < sizeof (pat))) {
+			memcpy( pat, list, n);
+			pat[n] = '\000';
+			if (!fnmatch( pat, s, 0))
+				return (1);
+		}
+		list += n;
+		list += strspn( list, " ,");
+	}
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * readfile: Read all of `fname' into `*buf' with a single pread(), and 
+ * return its length. The file stays open in `*fd', which must be -1 the
+ * first time. The buffer of `*size' bytes grows as needed and is zero
+ * terminated. Returns -1 on error. */
+
+int readfile( const char * fname, int * fd, char ** buf, int * size)
+{
+	int n;
+
+	if ((*fd == -1) && ((*fd = open( fname, O_RDONLY)) == -1))
+		return (-1);
+	if (!*buf)
+		*buf = xmalloc( *size = BUFSIZ);
+	while ((n = pread( *fd, *buf, *size-1, 0)) == *size-1)
+		*buf = xrealloc( *buf, *size *= 2);
+	if (n == -1)
+		return (-1);
+	(*buf)[n] = '\000';
+	return (n);
+}
@@ -0,0 +1,233 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * watch.c: The watch list: a few processes, named in the configuration
+ * file or picked by the user, that are pinned on top of the process list
+ * and sampled every `watch_period' seconds, apart from the updates. A
+ * timer wakes up xgetch() for the samples, and the stat and schedstat
+ * files of every watched process are kept open. Their CPU usage and RSS
+ * go to their history, which still has 1 second samples: each is the
+ * average of the samples taken within it. The samples are taken in the
+ * main loop, and the update in the SIGALRM handler moves the process
+ * table and the history, so that signal is blocked while sampling.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+int				watched[WATCH_MAX];		/* process table indices	*/
+
+int				nwatched		= 0;	/* # of watched processes	*/
+char *			watch_names		= NULL;	/* patterns to watch		*/
+double			watch_period	= WATCH_PERIOD;	/* seconds between samples */
+int				watch_timer		= -1;	/* timerfd for the samples	*/
+int				watch_wake_i	= -1;	/* its wake descriptor		*/
+int				watch_bufsize	= 0;	/* size of watch_buf		*/
+char *			watch_buf		= NULL;	/* contents of a file		*/
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void		watch_arm			(double);
+void		watch_start			(int);
+int			read_watch			(struct process_info *, double);
+
+/* ------------------------------------------------------------------------
+ * watch_arm: Let the timer fire every `period' seconds, or stop it when
+ * `period' is zero. */
+
+void watch_arm( double period)
+{
+	struct itimerspec its;
+
+	if (watch_timer == -1)
+		return;
+	its.it_interval.tv_sec = (time_t) period;
+	its.it_interval.tv_nsec = (long) ((period - (time_t) period) * 1e9);
+	its.it_value = its.it_interval;
+	timerfd_settime( watch_timer, 0, &its, NULL);
+}
+
+/* ------------------------------------------------------------------------
+ * watch_start: Put process `i' on the watch list. */
+
+void watch_start( int i)
+{
+	struct process_info * p = procs + i;
+
+	p->watched = 1;
+	p->watch_fd = p->watch_sched_fd = -1;
+	p->watch_t = p->watch_cpu = 0;
+	p->watch_run = 0;
+	watched[nwatched++] = i;
+	if (nwatched == 1)
+		watch_arm( watch_period);
+}
+
+/* ------------------------------------------------------------------------
+ * watch_check: Process `i' is new. It is watched if its name matches one
+ * of `watch_names'. If the watch list is full, it waits for a place. */
+
+void watch_check( int i)
+{
+	procs[i].watched = 0;
+	if (!watch_names || !match_list( watch_names, procs[i].comm))
+		return;
+	if (nwatched < WATCH_MAX)
+		watch_start( i);
+	else
+		procs[i].watched = WATCH_WAITING;
+}
+
+/* ------------------------------------------------------------------------
+ * watch_stop: Take process `i' off the watch list, if it is on it. The
+ * place goes to a process that waits for one. */
+
+void watch_stop( int i)
+{
+	struct process_info * p = procs + i;
+	int k;
+
+	if (p->watched <= 0)
+		return;
+	p->watched = 0;
+	if (p->watch_fd != -1)
+		close( p->watch_fd);
+	if (p->watch_sched_fd != -1)
+		close( p->watch_sched_fd);
+	p->watch_fd = p->watch_sched_fd = -1;
+	for (k=0; (k < nwatched) && (watched[k] != i); k++);
+	if (k < nwatched)
+		watched[k] = watched[--nwatched];
+	for (k=0; k<procs_maxi; k++)
+		if (procs[k].pid && (procs[k].watched == WATCH_WAITING)) {
+			watch_start( k);
+			return;
+		}
+	if (!nwatched)
+		watch_arm( 0);
+}
+
+/* ------------------------------------------------------------------------
+ * watch_toggle: Watch the process `pid', or stop watching it. Returns 1
+ * if it is watched now, 0 if not and -1 if it is gone or the watch list
+ * is full. */
+
+int watch_toggle( int pid)
+{
+	sigset_t set, oset;
+	int i, ret;
+
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	if ((i = proc_lookup( pid)) == -1)
+		ret = -1;
+	else if (procs[i].watched > 0) {
+		watch_stop( i);
+		ret = 0;
+	} else if (nwatched == WATCH_MAX)
+		ret = -1;
+	else {
+		watch_start( i);
+		ret = 1;
+	}
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	return (ret);
+}
+
+/* ------------------------------------------------------------------------
+ * read_watch: Sample watched process `p' at time `now'. The CPU usage is
+ * taken from schedstat in nanoseconds if the kernel has it, as 100 ms is
+ * only 10 ticks. */
+
+int read_watch( struct process_info * p, double now)
+{
+	char fname[FILENAME_MAX];
+	unsigned long utime, stime;
+	unsigned long long run;
+	double dt;
+	long rss;
+	char state;
+	int n;
+
+	sprintf( fname, "%s/%d/stat", procroot, p->pid);
+	if (readfile( fname, &p->watch_fd, &watch_buf, &watch_bufsize) == -1)
+		return (1);
+	if (sscanf( watch_buf, "%*d (%*[^)]) %c %*d %*d %*d %*d %*d %*u %*u "
+			"%*u %*u %*u %lu %lu %*d %*d %*d %*d %*d %*d %*u %*u %ld",
+			&state, &utime, &stime, &rss) != 4)
+		return (1);
+	dt = now - p->watch_t;
+
+	/* A kernel without schedstat is noticed here too, as read_sched()
+	 * only looks at the processes that are shown */
+
+	sprintf( fname, "%s/%d/schedstat", procroot, p->pid);
+	n = p->sched_missing ? -1 : readfile( fname, &p->watch_sched_fd,
+			&watch_buf, &watch_bufsize);
+	if ((n == -1) && (p->watch_sched_fd == -1) && (errno == ENOENT))
+		p->sched_missing = 1;
+	if ((n > 0) && (sscanf( watch_buf, "%llu", &run) == 1)) {
+		if (p->watch_run && (dt > 0))
+			p->watch_cpu = (run >= p->watch_run) ? (run - p->watch_run) *
+					100.0 / (dt * 1e9) : 0;
+		p->watch_run = run;
+	} else if (p->watch_t && (dt > 0))
+		p->watch_cpu = (utime + stime - p->watch_jiffies) * 100.0 /
+				(clk_tck * dt);
+	p->watch_jiffies = utime + stime;
+	p->watch_t = now;
+	p->state = state;
+	p->rss = rss * getpagesize();
+	return (0);
+}
+
+/* ------------------------------------------------------------------------
+ * watch_wake: Called when xgetch() was woken by a wake descriptor. Samples
+ * the watched processes if the timer fired, and returns nonzero if it
+ * did. */
+
+int watch_wake( void)
+{
+	unsigned long long n;
+	sigset_t set, oset;
+	double now;
+	int k;
+
+	if ((watch_wake_i == -1) || !wake_ready( watch_wake_i))
+		return (0);
+	if (read( watch_timer, &n, sizeof (n)) == -1)
+		return (0);
+	sigemptyset( &set);
+	sigaddset( &set, SIGALRM);
+	sigprocmask( SIG_BLOCK, &set, &oset);
+	now = mono_time();
+	for (k=0; k<nwatched; k++)
+		if (!read_watch( procs + watched[k], now))
+			hist_watch( watched[k], now);
+	sigprocmask( SIG_SETMASK, &oset, NULL);
+	return (1);
+}
+
+/* ------------------------------------------------------------------------
+ * watch_init: Create the timer. Without a timer, the watched processes
+ * are still pinned, but only sampled with the updates. */
+
+int watch_init( void)
+{
+	if (watch_period <= 0)
+		watch_period = WATCH_PERIOD;
+	watch_timer = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK |
+			TFD_CLOEXEC);
+	if ((watch_timer != -1) &&
+			((watch_wake_i = wake_add( watch_timer, POLLIN)) == -1)) {
+		close( watch_timer);
+		watch_timer = -1;
+	}
+	return (0);
+}
@@ -0,0 +1,156 @@
+/* vi: ts=4 sw=4
+ *
+ * Hifs -- Handy Information For Sysadmins
+ * Copyright (C) 1996,1997 Geert Jansen
+ *
+ * window.c: CPU usage of the processes over the last 1, 5 and 15 minutes.
+ * A process that used CPU time gets a ring of WIN_SLOTS buckets of
+ * WIN_BUCKET seconds, and a running sum per window: a bucket is added
+ * when it gets the time, and subtracted when it leaves the window. So the
+ * windows cost nothing to switch between. The windows are moved on once
+ * per update, when a new bucket starts, so reading them changes nothing.
+ * A process that exits is kept as a ghost until its time has left the
+ * longest window.
+ */
+
+#include "hifs.h"
+
+/* ------------------------------------------------------------------------
+ * Globals */
+
+struct process_info *	ghosts		= NULL;	/* exited processes			*/
+
+int					nghosts			= 0;	/* # of ghosts				*/
+int					ghosts_size		= 16;	/* initial ghost table size	*/
+double				win_start		= 0;	/* time of the first update */
+double				win_now			= 0;	/* time of this update		*/
+long				win_bucket		= 0;	/* bucket the windows are at */
+
+/* The length of each window, in buckets */
+
+int		win_buckets[WIN_NWINDOWS] = { 60 / WIN_BUCKET, 300 / WIN_BUCKET,
+									  900 / WIN_BUCKET };
+
+/* ------------------------------------------------------------------------
+ * Prototypes not in hifs.h */
+
+void		window_advance		(struct cpu_window *, long);
+
+/* ------------------------------------------------------------------------
+ * window_advance: Move window `w' on to bucket `b'. The buckets that leave
+ * each window are subtracted from its sum. After WIN_SLOTS buckets, all
+ * of them have left. Shortly after boot, a window reaches back before
+ * bucket 0, and nothing leaves it. */
+
+void window_advance( struct cpu_window * w, long b)
+{
+	int k;
+
+	if (b - w->bucket >= WIN_SLOTS) {
+		memset( w, 0, sizeof (struct cpu_window));
+		w->bucket = b;
+		return;
+	}
+	while (w->bucket < b) {
+		w->bucket++;
+		for (k=0; k<WIN_NWINDOWS; k++)
+			if (w->bucket >= win_buckets[k])
+				w->sum[k] -= w->slot[(w->bucket - win_buckets[k]) % WIN_SLOTS];
+		w->slot[w->bucket % WIN_SLOTS] = 0;
+	}
+}
+
+/* ------------------------------------------------------------------------
+ * window_add: Account `d' jiffies of CPU time to process `p' now. */
+
+void window_add( struct process_info * p, unsigned long d)
+{
+	long b;
+	int k;
+
+	b = win_bucket;
+	if (!p->win) {
+		p->win = xmalloc( sizeof (struct cpu_window));
+		memset( p->win, 0, sizeof (struct cpu_window));
+		p->win->bucket = b;
+	}
+	window_advance( p->win, b);
+	p->win->slot[b % WIN_SLOTS] += d;
+	for (k=0; k<WIN_NWINDOWS; k++)
+		p->win->sum[k] += d;
+}
+
+/* ------------------------------------------------------------------------
+ * window_pct: Return the CPU usage of process `p' in % over window `k'.
+ * The window ends at this update, and does not start before the first
+ * update. */
+
+double window_pct( struct process_info * p, int k)
+{
+	double secs;
+
+	if (!p->win || !p->win->sum[k])
+		return (0);
+	secs = (win_buckets[k] - 1) * WIN_BUCKET + fmod( win_now, WIN_BUCKET);
+	if (secs > win_now - win_start)
+		secs = win_now - win_start;
+	return (secs > 0 ? p->win->sum[k] * 100.0 / (clk_tck * secs) : 0);
+}
+
+/* ------------------------------------------------------------------------
+ * window_exit: Process `p' exited. If it used CPU time within the longest
+ * window, it is kept as a ghost. */
+
+void window_exit( struct process_info * p)
+{
+	if (!p->win)
+		return;
+	if (window_pct( p, WIN_NWINDOWS-1) == 0) {
+		free( p->win);
+		p->win = NULL;
+		return;
+	}
+	if (nghosts == ghosts_size)
+		ghosts = xrealloc( ghosts, (ghosts_size *= 2) *
+				sizeof (struct process_info));
+	ghosts[nghosts] = *p;
+	ghosts[nghosts++].state = 'X';
+	p->win = NULL;
+}
+
+/* ------------------------------------------------------------------------
+ * window_update: Called at the start of an update. When a new bucket has
+ * started, the windows of all processes and ghosts are moved on to it,
+ * and the ghosts whose time has left the longest window are dropped. */
+
+void window_update( void)
+{
+	long b;
+	int i;
+
+	win_now = mono_time();
+	if ((b = win_now / WIN_BUCKET) == win_bucket)
+		return;
+	win_bucket = b;
+	for (i=0; i<procs_maxi; i++)
+		if (procs[i].pid && procs[i].win)
+			window_advance( procs[i].win, b);
+	for (i=0; i<nghosts; i++)
+		window_advance( ghosts[i].win, b);
+	for (i=0; i<nghosts; i++)
+		if (window_pct( ghosts + i, WIN_NWINDOWS-1) == 0) {
+			free( ghosts[i].win);
+			ghosts[i--] = ghosts[--nghosts];
+		}
+}
+
+/* ------------------------------------------------------------------------
+ * window_init: Allocate the ghost table. */
+
+int window_init( void)
+{
+	ghosts = xmalloc( ghosts_size * sizeof (struct process_info));
+	win_start = win_now = mono_time();
+	win_bucket = win_now / WIN_BUCKET;
+	return (0);
+}